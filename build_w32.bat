@@ -236,9 +236,12 @@ if exist %OUTDIR%\link.sc del %OUTDIR%\link.sc
 
 call :Compile src/ar
 call :Compile src/arscan
+call :Compile src/cache
 call :Compile src/commands
 call :Compile src/default
 call :Compile src/dir
+call :Compile src/dump
+call :Compile src/events
 call :Compile src/expand
 call :Compile src/file
 call :Compile src/function
@@ -21,8 +21,14 @@ this program.  If not, see <http://www.gnu.org/licenses/>.  */
 
 #include "filedef.h"
 #include "dep.h"
+#include "debug.h"
+#include "hash.h"
 #include <fnmatch.h>
 
+#ifdef HAVE_UTIME_H
+# include <utime.h>
+#endif
+
 /* Return nonzero if NAME is an archive-member reference, zero if not.  An
    archive-member reference is a name like 'lib(member)' where member is a
    non-empty string.
@@ -66,6 +72,421 @@ ar_parse_name (const char *name, char **arname_p, char **memname_p)
 }
 
 
+#ifndef VMS
+
+/* Index of the members of an archive, so that looking up the dates of many
+   members costs one scan of the archive rather than one scan per member.
+   An index is rebuilt when the archive's modification time, size or inode
+   changes, and is dropped when make touches the archive or runs its
+   recipe.  After the recipe for a member runs only that member is read
+   again.  Building an index parses the archive's long name table once,
+   however many members are looked up.
+
+   The members of a thin archive are separate files: their dates are the
+   modification times of those files, found without reading the archive,
+   and touching a member touches its file.  */
+
+struct ar_member
+  {
+    const char *name;           /* Name as stored, without directories.  */
+    const char *path;           /* File holding a thin archive member.  */
+    long int date;              /* Modification time of the member.  */
+    unsigned int pos;           /* Position in the archive.  */
+    int truncated;              /* Nonzero if NAME may be truncated.  */
+  };
+
+struct ar_index
+  {
+    const char *arname;         /* Name of the archive (in the strcache).  */
+    FILE_TIMESTAMP mtime;       /* Identity of the archive when scanned.  */
+    off_t size;
+    ino_t ino;
+    struct hash_table members;  /* The members, by name.  */
+    struct ar_member **truncated; /* Members whose names may be truncated. */
+    unsigned int ntruncated;
+    unsigned int count;         /* Number of members.  */
+  };
+
+static struct hash_table ar_indexes;
+
+static unsigned long
+ar_index_hash_1 (const void *key)
+{
+  return_STRING_HASH_1 (((struct ar_index const *) key)->arname);
+}
+
+static unsigned long
+ar_index_hash_2 (const void *key)
+{
+  return_STRING_HASH_2 (((struct ar_index const *) key)->arname);
+}
+
+static int
+ar_index_hash_cmp (const void *x, const void *y)
+{
+  return_STRING_COMPARE (((struct ar_index const *) x)->arname,
+                         ((struct ar_index const *) y)->arname);
+}
+
+static unsigned long
+ar_member_hash_1 (const void *key)
+{
+  return_STRING_HASH_1 (((struct ar_member const *) key)->name);
+}
+
+static unsigned long
+ar_member_hash_2 (const void *key)
+{
+  return_STRING_HASH_2 (((struct ar_member const *) key)->name);
+}
+
+static int
+ar_member_hash_cmp (const void *x, const void *y)
+{
+  return_STRING_COMPARE (((struct ar_member const *) x)->name,
+                         ((struct ar_member const *) y)->name);
+}
+
+/* Free INDEX and everything it holds.  */
+
+static void
+free_ar_index (struct ar_index *index)
+{
+  hash_free (&index->members, 1);
+  free (index->truncated);
+  free (index);
+}
+
+/* This function is called by 'ar_scan' to add each member to an index.  */
+
+static long int
+ar_index_member (int desc UNUSED, const char *mem, int truncated,
+                 long int hdrpos UNUSED, long int datapos,
+                 long int size UNUSED, long int date,
+                 int uid UNUSED, int gid UNUSED, unsigned int mode UNUSED,
+                 const void *arg)
+{
+  struct ar_index *index = (struct ar_index *) arg;
+  struct ar_member key, **slot, *m;
+  const char *p;
+
+  /* Members of thin archives may be stored with a directory.  */
+  p = datapos < 0 ? strrchr (mem, '/') : 0;
+  key.name = p ? p + 1 : mem;
+  slot = (struct ar_member **) hash_find_slot (&index->members, &key);
+
+  /* If a name appears more than once, the first one wins.  */
+  if (HASH_VACANT (*slot))
+    {
+      m = xmalloc (sizeof (struct ar_member));
+      m->name = strcache_add (key.name);
+      m->path = datapos < 0 ? strcache_add (mem) : 0;
+      m->date = date;
+      m->pos = index->count;
+      m->truncated = ar_name_truncated (mem, truncated);
+      hash_insert_at (&index->members, m, slot);
+
+      if (m->truncated)
+        {
+          index->truncated = xrealloc (index->truncated,
+                                       (index->ntruncated + 1)
+                                       * sizeof (struct ar_member *));
+          index->truncated[index->ntruncated++] = m;
+        }
+    }
+
+  ++index->count;
+  return 0;
+}
+
+/* Return an up to date index of the archive ARNAME, or NULL if it can't
+   be read.  */
+
+static struct ar_index *
+get_ar_index (const char *arname)
+{
+  struct ar_index key, **slot, *index;
+  struct stat st;
+  int e;
+
+  if (ar_indexes.ht_vec == 0)
+    hash_init (&ar_indexes, 16, ar_index_hash_1, ar_index_hash_2,
+               ar_index_hash_cmp);
+
+  key.arname = arname;
+  slot = (struct ar_index **) hash_find_slot (&ar_indexes, &key);
+  index = HASH_VACANT (*slot) ? 0 : *slot;
+
+  STATS_COUNT (stats);
+  EINTRLOOP (e, stat (arname, &st));
+  if (e != 0)
+    {
+      if (index)
+        {
+          hash_delete_at (&ar_indexes, slot);
+          free_ar_index (index);
+        }
+      return 0;
+    }
+
+  if (index)
+    {
+      if (index->mtime == FILE_TIMESTAMP_STAT_MODTIME (arname, st)
+          && index->size == st.st_size && index->ino == st.st_ino)
+        return index;
+
+      DB (DB_VERBOSE, (_("Archive '%s' has changed; scanning it again.\n"),
+                       arname));
+      hash_delete_at (&ar_indexes, slot);
+      free_ar_index (index);
+      slot = (struct ar_index **) hash_find_slot (&ar_indexes, &key);
+    }
+
+  index = xcalloc (sizeof (struct ar_index));
+  index->arname = strcache_add (arname);
+  index->mtime = FILE_TIMESTAMP_STAT_MODTIME (arname, st);
+  index->size = st.st_size;
+  index->ino = st.st_ino;
+  hash_init (&index->members, 64, ar_member_hash_1, ar_member_hash_2,
+             ar_member_hash_cmp);
+
+  if (ar_scan (arname, ar_index_member, index) < 0)
+    {
+      free_ar_index (index);
+      return 0;
+    }
+
+  hash_insert_at (&ar_indexes, index, slot);
+  return index;
+}
+
+/* Forget the index of the archive NAME, or of the archive containing the
+   member NAME, because it may have changed.  */
+
+void
+ar_forget (const char *name)
+{
+  struct ar_index key, **slot;
+  char *arname = 0;
+
+  if (ar_indexes.ht_vec == 0 || ar_indexes.ht_fill == 0)
+    return;
+
+  if (ar_name (name))
+    {
+      char *memname;
+      ar_parse_name (name, &arname, &memname);
+      name = arname;
+    }
+
+  key.arname = name;
+  slot = (struct ar_index **) hash_find_slot (&ar_indexes, &key);
+  if (!HASH_VACANT (*slot))
+    {
+      struct ar_index *index = *slot;
+      hash_delete_at (&ar_indexes, slot);
+      free_ar_index (index);
+    }
+
+  free (arname);
+}
+
+/* Passed to 'ar_refresh_member'.  */
+
+struct ar_refresh
+  {
+    struct ar_index *index;
+    const char *memname;        /* The member to read again.  */
+    unsigned int pos;           /* Position of the current member.  */
+  };
+
+/* This function is called by 'ar_scan' to find the member being refreshed
+   and update its entry in the index.  */
+
+static long int
+ar_refresh_member (int desc UNUSED, const char *mem, int truncated,
+                   long int hdrpos UNUSED, long int datapos,
+                   long int size UNUSED, long int date,
+                   int uid UNUSED, int gid UNUSED, unsigned int mode UNUSED,
+                   const void *arg)
+{
+  struct ar_refresh *r = (struct ar_refresh *) arg;
+  struct ar_index *index = r->index;
+  unsigned int pos = r->pos++;
+  struct ar_member key, *m;
+  const char *p;
+
+  if (!ar_name_equal (r->memname, mem, truncated))
+    return 0;
+
+  p = datapos < 0 ? strrchr (mem, '/') : 0;
+  key.name = p ? p + 1 : mem;
+  m = hash_find_item (&index->members, &key);
+  if (m == 0)
+    {
+      /* A new member: add it as the scan of the whole archive would.  */
+      ar_index_member (desc, mem, truncated, hdrpos, datapos, size, date,
+                       uid, gid, mode, index);
+      m = hash_find_item (&index->members, &key);
+      m->pos = pos;
+    }
+
+  m->path = datapos < 0 ? strcache_add (mem) : 0;
+  m->date = date;
+  return 1;
+}
+
+/* The recipe for NAME has run.  If NAME is an archive member, the recipe
+   changed only that member: read its date again and keep the index of the
+   rest of the archive.  Otherwise forget the index of the archive NAME.  */
+
+void
+ar_notice_update (const char *name)
+{
+  struct ar_index key, *index;
+  struct ar_refresh r;
+  struct stat st;
+  char *arname, *memname;
+  int e;
+
+  if (!ar_name (name))
+    {
+      ar_forget (name);
+      return;
+    }
+
+  if (ar_indexes.ht_vec == 0 || ar_indexes.ht_fill == 0)
+    return;
+
+  ar_parse_name (name, &arname, &memname);
+  key.arname = arname;
+  index = hash_find_item (&ar_indexes, &key);
+
+  if (index != 0)
+    {
+      r.index = index;
+      r.memname = memname;
+      r.pos = 0;
+
+      STATS_COUNT (stats);
+      EINTRLOOP (e, stat (arname, &st));
+      if (e == 0 && ar_scan (arname, ar_refresh_member, &r) > 0)
+        {
+          index->mtime = FILE_TIMESTAMP_STAT_MODTIME (arname, st);
+          index->size = st.st_size;
+          index->ino = st.st_ino;
+        }
+      else
+        ar_forget (arname);
+    }
+
+  free (arname);
+}
+
+/* Return the entry for MEMNAME in INDEX, or NULL if there is none.  */
+
+static struct ar_member *
+ar_index_find (struct ar_index *index, const char *memname)
+{
+  struct ar_member key, *m;
+  const char *p;
+  unsigned int i;
+
+  /* Members are stored without directories.  */
+  p = strrchr (memname, '/');
+  key.name = p ? p + 1 : memname;
+  m = hash_find_item (&index->members, &key);
+
+  /* A truncated name earlier in the archive would have matched first.  */
+  for (i = 0; i < index->ntruncated; ++i)
+    {
+      struct ar_member *t = index->truncated[i];
+      if ((m == 0 || t->pos < m->pos)
+          && ar_name_equal (memname, t->name, 1))
+        m = t;
+    }
+
+  return m;
+}
+
+/* Return the name of the file holding the member M of the thin archive
+   ARNAME, in newly allocated memory.  */
+
+static char *
+ar_thin_path (const char *arname, const struct ar_member *m)
+{
+  /* Relative names in a thin archive are relative to its directory.  */
+  const char *p = strrchr (arname, '/');
+  size_t l;
+  char *buf;
+
+  if (*m->path == '/' || p == 0)
+    return xstrdup (m->path);
+
+  l = p - arname + 1;
+  buf = xmalloc (l + strlen (m->path) + 1);
+  memcpy (buf, arname, l);
+  strcpy (buf + l, m->path);
+  return buf;
+}
+
+/* Look up MEMNAME in the archive ARNAME.  Return its date, 0 if it is not
+   in the archive, or -1 if the archive can't be read.  */
+
+static long int
+ar_index_date (const char *arname, const char *memname)
+{
+  struct ar_index *index = get_ar_index (arname);
+  struct ar_member *m;
+
+  if (index == 0)
+    return -1;
+
+  m = ar_index_find (index, memname);
+  if (m == 0)
+    return 0;
+
+  if (m->path)
+    {
+      char *path = ar_thin_path (arname, m);
+      struct stat st;
+      int e;
+
+      STATS_COUNT (stats);
+      EINTRLOOP (e, stat (path, &st));
+      free (path);
+      return e == 0 ? st.st_mtime : 0;
+    }
+
+  return m->date;
+}
+
+#ifdef HAVE_UTIME_H
+/* If MEMNAME is a member of the thin archive ARNAME, return the name of
+   the file holding it in newly allocated memory.  Otherwise return NULL.  */
+
+static char *
+ar_thin_member (const char *arname, const char *memname)
+{
+  struct ar_index *index = get_ar_index (arname);
+  struct ar_member *m = index ? ar_index_find (index, memname) : 0;
+
+  return m != 0 && m->path != 0 ? ar_thin_path (arname, m) : 0;
+}
+#endif
+
+#else /* VMS */
+
+void
+ar_forget (const char *name UNUSED)
+{
+}
+
+void
+ar_notice_update (const char *name UNUSED)
+{
+}
+
 /* This function is called by 'ar_scan' to find which member to look at.  */
 
 /* ARGSUSED */
@@ -79,6 +500,8 @@ ar_member_date_1 (int desc UNUSED, const char *mem, int truncated,
   return ar_name_equal (name, mem, truncated) ? date : 0;
 }
 
+#endif /* VMS */
+
 /* Return the modtime of NAME.  */
 
 time_t
@@ -107,7 +530,11 @@ ar_member_date (const char *name)
       (void) f_mtime (arfile, 0);
   }
 
+#ifndef VMS
+  val = ar_index_date (arname, memname);
+#else
   val = ar_scan (arname, ar_member_date_1, memname);
+#endif
 
   free (arname);
 
@@ -140,7 +567,27 @@ ar_touch (const char *name)
     f_mtime (arfile, 0);
   }
 
+#ifdef HAVE_UTIME_H
+  /* The date of a thin archive member is that of the file holding it.  */
+  {
+    char *path = ar_thin_member (arname, memname);
+
+    if (path != 0)
+      {
+        int e;
+
+        EINTRLOOP (e, utime (path, 0));
+        if (e != 0)
+          perror_with_name ("touch: ", path);
+        free (path);
+        free (arname);
+        return e != 0;
+      }
+  }
+#endif
+
   val = 1;
+  ar_forget (arname);
   switch (ar_member_touch (arname, memname))
     {
     case -1:
@@ -183,6 +183,9 @@ VMS_get_member_info(struct dsc$descriptor_s *module, unsigned long *rfa)
      member name might be truncated flag,
      member header position in file,
      member data position in file,
+       or -1 if the data is not in the archive: in a thin archive,
+       member names are the names of the files holding the data,
+       relative to the directory of the archive,
      member data size,
      member date,
      member uid,
@@ -403,6 +406,10 @@ parse_int (const char *ptr, const size_t len, const int base,
   return val;
 }
 
+#if defined(SARMAG) && !defined(THINMAG)
+# define THINMAG "!<thin>\n"  /* String that begins a GNU thin archive.  */
+#endif
+
 /* Takes three arguments ARCHIVE, FUNCTION and ARG.
 
    Open the archive named ARCHIVE, find its members one by one,
@@ -442,6 +449,7 @@ ar_scan (const char *archive, ar_member_func_t function, const void *arg)
 #endif
   char *namemap = 0;
   int namemap_size = 0;
+  int thin = 0;
   int desc = open (archive, O_RDONLY, 0);
   if (desc < 0)
     return -1;
@@ -451,7 +459,11 @@ ar_scan (const char *archive, ar_member_func_t function, const void *arg)
     char buf[SARMAG];
     int nread;
     nread = readbuf (desc, buf, SARMAG);
-    if (nread != SARMAG || memcmp (buf, ARMAG, SARMAG))
+    if (nread != SARMAG)
+      goto invalid;
+    if (!memcmp (buf, THINMAG, SARMAG))
+      thin = 1;
+    else if (memcmp (buf, ARMAG, SARMAG))
       goto invalid;
   }
 #else
@@ -558,6 +570,7 @@ ar_scan (const char *archive, ar_member_func_t function, const void *arg)
         char namebuf[ARNAME_MAX + 1];
         char *name;
         int is_namemap;         /* Nonzero if this entry maps long names.  */
+        int is_symtab;          /* Nonzero if this entry is a symbol table. */
         int long_name = 0;
 #endif
         long int eltsize;
@@ -680,6 +693,10 @@ ar_scan (const char *archive, ar_member_func_t function, const void *arg)
              that.  */
           is_namemap = (!strcmp (name, "//")
                         || !strcmp (name, "ARFILENAMES/"));
+
+          /* The symbol table is the only other member whose data is in a
+             thin archive.  */
+          is_symtab = (!strcmp (name, "/") || !strcmp (name, "/SYM64/"));
 #endif  /* Not AIAMAG. */
 
           /* On some systems, there is a slash after each member name.  */
@@ -739,7 +756,9 @@ ar_scan (const char *archive, ar_member_func_t function, const void *arg)
 
         fnval =
           (*function) (desc, name, ! long_name, member_offset,
-                       member_offset + AR_HDR_SIZE, eltsize,
+                       (thin && !is_namemap && !is_symtab
+                        ? -1L : member_offset + (long int) AR_HDR_SIZE),
+                       eltsize,
 #ifndef M_XENIX
                        parse_int (TOCHAR (member_header.ar_date), sizeof (member_header.ar_date), 10, "date", archive, name),
                        parse_int (TOCHAR (member_header.ar_uid), sizeof (member_header.ar_uid), 10, "uid", archive, name),
@@ -756,6 +775,7 @@ ar_scan (const char *archive, ar_member_func_t function, const void *arg)
         if (fnval)
           {
             (void) close (desc);
+            free (namemap);
             return fnval;
           }
 
@@ -785,7 +805,8 @@ ar_scan (const char *archive, ar_member_func_t function, const void *arg)
 
             if (eltsize > INT_MAX)
               goto invalid;
-            namemap = alloca (eltsize + 1);
+            free (namemap);
+            namemap = xmalloc (eltsize + 1);
             nread = readbuf (desc, namemap, eltsize);
             if (nread != eltsize)
               goto invalid;
@@ -805,11 +826,12 @@ ar_scan (const char *archive, ar_member_func_t function, const void *arg)
                   }
               }
             *limit = '\0';
-
-            is_namemap = 0;
           }
 
-        member_offset += AR_HDR_SIZE + eltsize;
+        /* The data of most members of a thin archive is elsewhere.  */
+        member_offset += AR_HDR_SIZE;
+        if (!thin || is_namemap || is_symtab)
+          member_offset += eltsize;
         if (member_offset % 2 != 0)
           member_offset++;
 #endif
@@ -817,10 +839,12 @@ ar_scan (const char *archive, ar_member_func_t function, const void *arg)
   }
 
   close (desc);
+  free (namemap);
   return 0;
 
  invalid:
   close (desc);
+  free (namemap);
   return -2;
 }
 #endif /* !VMS */
@@ -882,6 +906,27 @@ ar_name_equal (const char *name, const char *mem, int truncated)
 }
 
 #ifndef VMS
+/* Return nonzero if MEM, given to an 'ar_scan' function with TRUNCATED,
+   may be the truncated name of a longer member: that is, if it fills the
+   whole name field of the member header.  */
+
+int
+ar_name_truncated (const char *mem, int truncated)
+{
+#ifdef AIAMAG
+  return 0;
+#else
+  struct ar_hdr hdr;
+  if (!truncated)
+    return 0;
+#if !defined (__hpux) && !defined (cray)
+  return strlen (mem) >= sizeof (hdr.ar_name) - 1;
+#else
+  return strlen (mem) >= sizeof (hdr.ar_name) - 2;
+#endif /* !__hpux && !cray */
+#endif /* !AIAMAG */
+}
+
 /* ARGSUSED */
 static long int
 ar_member_pos (int desc UNUSED, const char *mem, int truncated,
@@ -0,0 +1,567 @@
+/* Local cache of the results of recipes for GNU Make.
+Copyright (C) 2020 Free Software Foundation, Inc.
+This file is part of GNU Make.
+
+GNU Make is free software; you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or (at your option) any later
+version.
+
+GNU Make is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#include "makeint.h"
+
+#include "filedef.h"
+#include "dep.h"
+#include "job.h"
+#include "commands.h"
+#include "variable.h"
+#include "debug.h"
+
+#ifdef HAVE_FCNTL_H
+# include <fcntl.h>
+#else
+# include <sys/file.h>
+#endif
+
+#ifdef HAVE_LINUX_FS_H
+# include <sys/ioctl.h>
+# include <linux/fs.h>
+#endif
+
+#ifdef WINDOWS32
+# include <direct.h>
+# define MKDIR(_d)  _mkdir (_d)
+#else
+# define MKDIR(_d)  mkdir ((_d), 0777)
+#endif
+
+/* The results of a recipe for a target marked .CACHEABLE are kept in an
+   entry in the cache directory.  The entry is named by a hash of all the
+   inputs the recipe is assumed to depend on: the names of its targets, its
+   command lines after expansion, the variables in its environment that
+   matter, and the names and contents of the target's normal prerequisites.
+
+   An entry is a directory holding a copy of each target the recipe made,
+   named "0" for the target itself and "1", "2", ... for the files in its
+   'also_make' list, and the standard output and standard error of the
+   recipe in "out" and "err".  It is built under a temporary name and
+   renamed into place, so a partly written entry is never used.  */
+
+#define CACHE_DIR_DEFAULT   ".make-cache"
+
+/* Inherited environment variables that count when .CACHE_ENV is not set.  */
+
+#define CACHE_ENV_DEFAULT   "PATH"
+
+/* Environment variables which change from one invocation of make to the
+   next without changing what a recipe does.  */
+
+static const char *const ignored_env[] =
+  {
+    "MAKEFLAGS", "MFLAGS", "MAKELEVEL", 0
+  };
+
+/* The key is a 64-bit FNV-1a hash.  */
+
+#define HASH_MASK   (((uintmax_t) 0xffffffffUL << 32) | 0xffffffffUL)
+#define HASH_INIT   (((uintmax_t) 0xcbf29ce4UL << 32) | 0x84222325UL)
+#define HASH_PRIME  (((uintmax_t) 1 << 40) | 0x1b3)
+
+static void
+hash_bytes (uintmax_t *hash, const void *buf, size_t len)
+{
+  const unsigned char *p = buf;
+  uintmax_t h = *hash;
+
+  while (len-- > 0)
+    h = ((h ^ *p++) * HASH_PRIME) & HASH_MASK;
+
+  *hash = h;
+}
+
+/* Add S, and its terminating nul to keep it apart from what follows.  */
+
+static void
+hash_string (uintmax_t *hash, const char *s)
+{
+  hash_bytes (hash, s, strlen (s) + 1);
+}
+
+/* Add the contents of the file NAME, or a marker if it is not a regular
+   file we can read.  */
+
+static void
+hash_file (uintmax_t *hash, const char *name)
+{
+  static char buf[65536];
+  struct stat st;
+  int fd;
+  int r;
+
+  EINTRLOOP (fd, open (name, O_RDONLY));
+  if (fd < 0)
+    {
+      hash_string (hash, "-");
+      return;
+    }
+
+  EINTRLOOP (r, fstat (fd, &st));
+  if (r != 0 || !S_ISREG (st.st_mode))
+    hash_string (hash, "-");
+  else
+    {
+      hash_string (hash, "+");
+      while (1)
+        {
+          EINTRLOOP (r, read (fd, buf, sizeof (buf)));
+          if (r <= 0)
+            break;
+          hash_bytes (hash, buf, r);
+        }
+    }
+
+  close (fd);
+}
+
+/* Return the files made by the recipe for FILE, FILE first, in a newly
+   allocated array ending with a null pointer.  */
+
+static struct file **
+recipe_targets (struct file *file)
+{
+  struct file **targets;
+  struct dep *d;
+  unsigned int n = 1;
+
+  for (d = file->also_make; d != 0; d = d->next)
+    ++n;
+
+  targets = xmalloc ((n + 1) * sizeof (struct file *));
+  n = 0;
+  targets[n++] = file;
+  for (d = file->also_make; d != 0; d = d->next)
+    if (d->file != file)
+      targets[n++] = d->file;
+  targets[n] = 0;
+
+  return targets;
+}
+
+/* Return the names of the inherited environment variables that can change
+   what the recipe for FILE does, in newly allocated memory.  */
+
+static char *
+cache_env (struct file *file)
+{
+  struct variable *v = lookup_variable (STRING_SIZE_TUPLE (".CACHE_ENV"));
+
+  if (v == 0)
+    return xstrdup (CACHE_ENV_DEFAULT);
+
+  return allocated_variable_expand_for_file ("$(.CACHE_ENV)", file);
+}
+
+/* Return nonzero if the environment setting NAME=VALUE in DEF may change
+   what the recipe for FILE does.  Variables make inherited from its own
+   environment are likely to differ from one session to the next, so they
+   only count if they are listed in KEEP.  */
+
+static int
+env_matters (const char *def, const char *keep, struct file *file)
+{
+  struct variable_set_list *save = current_variable_set_list;
+  const char *const *ip;
+  const char *eq = strchr (def, '=');
+  size_t len = eq ? (size_t) (eq - def) : strlen (def);
+  struct variable *v;
+  const char *p;
+  const char *w;
+  size_t wlen;
+
+  for (ip = ignored_env; *ip != 0; ++ip)
+    if (strlen (*ip) == len && strneq (def, *ip, len))
+      return 0;
+
+  if (file->variables != 0)
+    current_variable_set_list = file->variables;
+  v = lookup_variable (def, len);
+  current_variable_set_list = save;
+
+  if (v == 0 || (v->origin != o_env && v->origin != o_env_override))
+    return 1;
+
+  p = keep;
+  while ((w = find_next_token (&p, &wlen)) != 0)
+    if (wlen == len && strneq (def, w, len))
+      return 1;
+
+  return 0;
+}
+
+/* Return the name of the cache entry for the recipe of child C, in newly
+   allocated memory.  */
+
+static char *
+cache_entry_name (struct child *c)
+{
+  struct file *file = c->file;
+  uintmax_t hash = HASH_INIT;
+  unsigned int i, n;
+  char **env;
+  char *keep;
+  struct file **targets;
+  struct dep *d;
+  char *dir;
+  char *entry;
+
+  hash_string (&hash, "GNU make cache 1");
+
+  targets = recipe_targets (file);
+  for (i = 0; targets[i] != 0; ++i)
+    hash_string (&hash, targets[i]->name);
+  free (targets);
+
+  for (i = 0; i < file->cmds->ncommand_lines; ++i)
+    hash_string (&hash, c->command_lines[i]);
+
+  /* The environment is built from a hash table, so put it into a stable
+     order first.  */
+  if (c->environment == 0)
+    c->environment = target_environment (file);
+  for (n = 0; c->environment[n] != 0; ++n)
+    ;
+  env = xmalloc ((n + 1) * sizeof (char *));
+  memcpy (env, c->environment, (n + 1) * sizeof (char *));
+  qsort (env, n, sizeof (char *), alpha_compare);
+  keep = cache_env (file);
+  for (i = 0; i < n; ++i)
+    if (env_matters (env[i], keep, file))
+      hash_string (&hash, env[i]);
+  free (keep);
+  free (env);
+
+  /* Order-only prerequisites don't affect whether the target is remade,
+     so they don't affect which entry it comes from either.  */
+  for (d = file->deps; d != 0; d = d->next)
+    if (!d->ignore_mtime && d->file != 0)
+      {
+        hash_string (&hash, d->file->name);
+        hash_file (&hash, d->file->name);
+      }
+
+  dir = allocated_variable_expand_for_file ("$(.CACHE_DIR)", file);
+  if (*dir == '\0')
+    {
+      free (dir);
+      dir = xstrdup (CACHE_DIR_DEFAULT);
+    }
+
+  entry = xmalloc (strlen (dir) + 1 + 16 + 1);
+  sprintf (entry, "%s/%08lx%08lx", dir, (unsigned long) (hash >> 32),
+           (unsigned long) (hash & 0xffffffffUL));
+  free (dir);
+
+  return entry;
+}
+
+/* Copy everything from the current position of FROM to TO.
+   Returns nonzero on success.  */
+
+static int
+copy_fd (int from, int to)
+{
+  static char buf[65536];
+
+  while (1)
+    {
+      int r;
+      EINTRLOOP (r, read (from, buf, sizeof (buf)));
+      if (r < 0)
+        return 0;
+      if (r == 0)
+        return 1;
+      if (writebuf (to, buf, r) != r)
+        return 0;
+    }
+}
+
+/* Replace DST with a copy of SRC.  Share SRC's data with a reflink where
+   the system supports it, else copy the contents.  DST is never a hard link
+   to SRC: a later command could change it in place, and the cache entry
+   with it.  Returns nonzero on success.  */
+
+static int
+copy_file (const char *src, const char *dst)
+{
+  struct stat st;
+  int from, to;
+  int ok = 0;
+  int r;
+
+  EINTRLOOP (from, open (src, O_RDONLY));
+  if (from < 0)
+    return 0;
+  EINTRLOOP (r, fstat (from, &st));
+  if (r != 0 || !S_ISREG (st.st_mode))
+    {
+      close (from);
+      return 0;
+    }
+
+  unlink (dst);
+  EINTRLOOP (to, open (dst, O_WRONLY|O_CREAT|O_TRUNC, st.st_mode & 0777));
+  if (to < 0)
+    {
+      close (from);
+      return 0;
+    }
+
+#ifdef FICLONE
+  EINTRLOOP (r, ioctl (to, FICLONE, from));
+  ok = r == 0;
+#endif
+
+  if (!ok)
+    ok = copy_fd (from, to);
+
+  close (from);
+  if (close (to) != 0)
+    ok = 0;
+  if (!ok)
+    unlink (dst);
+
+  return ok;
+}
+
+/* Return the name of file NAME in cache entry ENTRY, in memory that is
+   overwritten by the next call.  */
+
+static const char *
+entry_file (const char *entry, const char *name)
+{
+  static char *buf = 0;
+  static size_t len = 0;
+  size_t need = strlen (entry) + 1 + strlen (name) + 1;
+
+  if (need > len)
+    {
+      len = need * 2;
+      buf = xrealloc (buf, len);
+    }
+  sprintf (buf, "%s/%s", entry, name);
+
+  return buf;
+}
+
+/* Bring the targets of child C up to date from cache entry ENTRY, and show
+   the output their recipe wrote.  Returns nonzero on success.  */
+
+static int
+restore_entry (struct child *c, const char *entry)
+{
+  struct file **targets = recipe_targets (c->file);
+  char num[INTSTR_LENGTH + 1];
+  struct stat st;
+  unsigned int i;
+  int r;
+  int is_err;
+
+  /* Don't touch any target unless we can restore all of them.  */
+  for (i = 0; targets[i] != 0; ++i)
+    {
+      sprintf (num, "%u", i);
+      EINTRLOOP (r, stat (entry_file (entry, num), &st));
+      if (r != 0 || !S_ISREG (st.st_mode))
+        break;
+    }
+
+  if (targets[i] == 0)
+    for (i = 0; targets[i] != 0; ++i)
+      {
+        sprintf (num, "%u", i);
+        if (!copy_file (entry_file (entry, num), targets[i]->name))
+          break;
+      }
+
+  r = targets[i] == 0;
+  free (targets);
+  if (!r)
+    return 0;
+
+#ifndef NO_OUTPUT_SYNC
+  /* Keep the output together as if the recipe had run.  */
+  c->output.syncout = 1;
+#endif
+
+  for (is_err = 0; is_err <= 1; ++is_err)
+    {
+      char *buf;
+      int fd;
+
+      EINTRLOOP (fd, open (entry_file (entry, is_err ? "err" : "out"),
+                           O_RDONLY));
+      if (fd < 0)
+        continue;
+      EINTRLOOP (r, fstat (fd, &st));
+      if (r == 0 && st.st_size > 0)
+        {
+          buf = xmalloc (st.st_size + 1);
+          EINTRLOOP (r, read (fd, buf, st.st_size));
+          buf[r > 0 ? r : 0] = '\0';
+          outputs (is_err, buf);
+          free (buf);
+        }
+      close (fd);
+    }
+
+  return 1;
+}
+
+/* Look for the results of the recipe for child C in the cache.  If they are
+   there, restore them and return nonzero.  Otherwise remember where to save
+   them once the recipe has run, and return zero.  */
+
+int
+cache_lookup (struct child *c)
+{
+  char *entry = cache_entry_name (c);
+  struct stat st;
+  int r;
+
+  /* With -B the user wants the recipes to be run.  */
+  if (!always_make_flag)
+    {
+      EINTRLOOP (r, stat (entry, &st));
+      if (r == 0 && S_ISDIR (st.st_mode) && restore_entry (c, entry))
+        {
+          DB (DB_JOBS, (_("Restored '%s' from cache entry '%s'.\n"),
+                        c->file->name, entry));
+          free (entry);
+          return 1;
+        }
+    }
+
+  DB (DB_JOBS, (_("No usable cache entry '%s' for '%s'.\n"),
+                entry, c->file->name));
+  c->cache_entry = entry;
+
+  return 0;
+}
+
+/* Remove the temporary entry TMP, which holds NFILES targets.  */
+
+static void
+remove_entry (const char *tmp, unsigned int nfiles)
+{
+  char num[INTSTR_LENGTH + 1];
+  unsigned int i;
+
+  for (i = 0; i < nfiles; ++i)
+    {
+      sprintf (num, "%u", i);
+      unlink (entry_file (tmp, num));
+    }
+  unlink (entry_file (tmp, "out"));
+  unlink (entry_file (tmp, "err"));
+  rmdir (tmp);
+}
+
+#ifndef NO_OUTPUT_SYNC
+/* Save the output captured in FD as NAME in the temporary entry TMP.  */
+
+static int
+save_output (const char *tmp, const char *name, int fd)
+{
+  int to;
+  int ok;
+
+  if (fd < 0 || lseek (fd, 0, SEEK_SET) != 0)
+    return 1;
+
+  EINTRLOOP (to, open (entry_file (tmp, name), O_WRONLY|O_CREAT|O_TRUNC,
+                       0666));
+  if (to < 0)
+    return 0;
+
+  ok = copy_fd (fd, to);
+  if (close (to) != 0)
+    ok = 0;
+
+  return ok;
+}
+#endif
+
+/* The recipe for child C has succeeded: save its targets and output in the
+   cache entry chosen by cache_lookup.  */
+
+void
+cache_store (struct child *c)
+{
+  static int warned = 0;
+  const char *entry = c->cache_entry;
+  char num[INTSTR_LENGTH + 1];
+  struct file **targets;
+  char *dir, *tmp;
+  const char *sep;
+  unsigned int i;
+  int r;
+
+  /* Make sure the cache directory exists.  */
+  sep = strrchr (entry, '/');
+  dir = xstrndup (entry, sep - entry);
+  if (MKDIR (dir) != 0 && errno != EEXIST)
+    {
+      if (!warned)
+        OSS (error, NILF, _("cannot create cache directory '%s': %s"),
+             dir, strerror (errno));
+      warned = 1;
+      free (dir);
+      return;
+    }
+  free (dir);
+
+  tmp = xmalloc (strlen (entry) + CSTRLEN (".tmp") + INTSTR_LENGTH + 1);
+  sprintf (tmp, "%s.tmp%ld", entry, (long) getpid ());
+  if (MKDIR (tmp) != 0)
+    {
+      free (tmp);
+      return;
+    }
+
+  targets = recipe_targets (c->file);
+  for (i = 0; targets[i] != 0; ++i)
+    {
+      sprintf (num, "%u", i);
+      if (!copy_file (targets[i]->name, entry_file (tmp, num)))
+        break;
+    }
+  r = targets[i] == 0;
+  free (targets);
+  if (!r)
+    goto fail;
+
+#ifndef NO_OUTPUT_SYNC
+  if (!save_output (tmp, "out", c->output.out)
+      || (c->output.err != c->output.out
+          && !save_output (tmp, "err", c->output.err)))
+    goto fail;
+#endif
+
+  /* If another make saved the same entry first, keep that one.  */
+  if (rename (tmp, entry) != 0)
+    goto fail;
+
+  DB (DB_JOBS, (_("Saved '%s' in cache entry '%s'.\n"), c->file->name, entry));
+  free (tmp);
+  return;
+
+ fail:
+  remove_entry (tmp, i);
+  free (tmp);
+}
@@ -20,6 +20,7 @@ this program.  If not, see <http://www.gnu.org/licenses/>.  */
 #include "variable.h"
 #include "job.h"
 #include "commands.h"
+#include "dump.h"
 #ifdef WINDOWS32
 #include <windows.h>
 #include "w32err.h"
@@ -461,19 +462,35 @@ execute_file_commands (struct file *file)
       return;
     }
 
+  /* If this is a loaded dynamic object, unload it before remaking.
+     Some systems don't support overwriting a loaded object.  */
+  if (file->loaded)
+    unload_file (file->name);
+
+#ifndef VMS
+  /* Under -q we only need to know whether the recipe does anything.  That
+     is settled without a job unless some line is recursive.  */
+  if (question_flag && !file->cmds->any_recurse)
+    {
+      question_commands (file);
+      return;
+    }
+#endif
+
   /* First set the automatic variables according to this file.  */
 
   initialize_file_variables (file, 0);
 
   set_file_variables (file);
 
-  /* If this is a loaded dynamic object, unload it before remaking.
-     Some systems don't support overwriting a loaded object.  */
-  if (file->loaded)
-    unload_file (file->name);
-
-  /* Start the commands running.  */
-  new_job (file);
+  /* Start the commands running.  Under -n, a recipe with no recursive lines
+     is only printed, which needs no job either.  */
+#ifndef VMS
+  if (just_print_flag && !file->cmds->any_recurse)
+    just_print_commands (file);
+  else
+#endif
+    new_job (file);
 }
 
 /* This is set while we are inside fatal_error_signal,
@@ -709,3 +726,44 @@ print_commands (const struct commands *cmds)
       s = end + (end[0] == '\n');
     }
 }
+
+/* Write out the commands in CMDS for --print-data-base=json.  */
+
+void
+dump_commands (const struct commands *cmds)
+{
+  const char *s;
+
+  dump_begin_object ("recipe");
+
+  if (cmds->fileinfo.filenm != 0)
+    {
+      dump_str ("file", cmds->fileinfo.filenm);
+      dump_uint ("line", cmds->fileinfo.lineno);
+    }
+
+  dump_begin_array ("lines");
+
+  s = cmds->commands;
+  while (*s != '\0')
+    {
+      const char *end;
+      int bs;
+
+      /* Write one full logical recipe line: find a non-escaped newline.  */
+      for (end = s, bs = 0; *end != '\0'; ++end)
+        {
+          if (*end == '\n' && !bs)
+            break;
+
+          bs = *end == '\\' ? !bs : 0;
+        }
+
+      dump_strn (0, s, end - s);
+
+      s = end + (end[0] == '\n');
+    }
+
+  dump_end_array ();
+  dump_end_object ();
+}
@@ -25,6 +25,9 @@ this program.  If not, see <http://www.gnu.org/licenses/>.  */
 
 #define DB_ALL          (0xfff)
 
+/* Expansion profiling is expensive, so it is not part of DB_ALL.  */
+#define DB_PROFILE      (0x1000)
+
 extern int db_level;
 
 #define ISDB(_l)    ((_l)&db_level)
@@ -53,7 +53,8 @@ struct nameseq
     unsigned int staticpattern : 1;             \
     unsigned int need_2nd_expansion : 1;        \
     unsigned int ignore_automatic_vars : 1;     \
-    unsigned int is_explicit : 1;
+    unsigned int is_explicit : 1;               \
+    unsigned int wait_here : 1;
 
 struct dep
   {
@@ -135,3 +136,5 @@ struct dep *copy_dep_chain (const struct dep *d);
 struct goaldep *read_all_makefiles (const char **makefiles);
 void eval_buffer (char *buffer, const floc *floc);
 enum update_status update_goal_chain (struct goaldep *goals);
+void watch_goal_chain (struct goaldep *goals, struct goaldep *makefiles)
+  NORETURN;
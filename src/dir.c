@@ -534,9 +534,11 @@ find_directory (const char *name)
          tend--)
       *tend = '\0';
 
+    STATS_COUNT (stats);
     r = stat (tem, &st);
   }
 #else
+  STATS_COUNT (stats);
   EINTRLOOP (r, stat (name, &st));
 #endif
 
@@ -610,6 +612,7 @@ find_directory (const char *name)
 
       dc->counter = command_count;
 
+      STATS_COUNT (opendirs);
       ENULLLOOP (dc->dirstream, opendir (name));
       if (dc->dirstream == 0)
         /* Couldn't open the directory.  Mark this by setting the
@@ -724,6 +727,7 @@ dir_contents_file_exists_p (struct directory_contents *dir,
       struct dirfile dirfile_key;
       struct dirfile **dirfile_slot;
 
+      STATS_COUNT (readdirs);
       ENULLLOOP (d, readdir (dir->dirstream));
       if (d == 0)
         {
@@ -1202,6 +1206,18 @@ print_dir_data_base (void)
     printf ("%u", impossible);
   printf (_(" impossibilities in %lu directories.\n"), directories.ht_fill);
 }
+
+/* Print the statistics of the directory hash tables, for --stats.  */
+
+void
+print_dir_stats (void)
+{
+  fputs (_("# directories hash-table: "), stdout);
+  hash_print_stats (&directories, stdout);
+  fputs (_("\n# directory contents hash-table: "), stdout);
+  hash_print_stats (&directory_contents, stdout);
+  putc ('\n', stdout);
+}
 
 /* Hooks for globbing.  */
 
@@ -1330,6 +1346,7 @@ local_stat (const char *path, struct stat *buf)
     }
 #endif
 
+  STATS_COUNT (stats);
   EINTRLOOP (e, stat (path, buf));
   return e;
 }
@@ -1356,6 +1373,7 @@ static int
 local_lstat (const char *path, struct stat *buf)
 {
   int e;
+  STATS_COUNT (stats);
   EINTRLOOP (e, lstat (path, buf));
   return e;
 }
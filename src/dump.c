@@ -0,0 +1,302 @@
+/* Machine-readable dump of the data base for GNU Make.
+Copyright (C) 2020 Free Software Foundation, Inc.
+This file is part of GNU Make.
+
+GNU Make is free software; you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or (at your option) any later
+version.
+
+GNU Make is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#include "makeint.h"
+
+#include "dump.h"
+#include "hash.h"
+
+/* The dump is collected in a large buffer which is handed to stdio whole,
+   so a big data base costs a few large writes rather than one call into
+   stdio for every word.  When it goes to a file rather than stdout, the
+   buffer grows to hold all of it: several makes may append to the file at
+   once, and a single write keeps their lines whole.  */
+
+#define DUMP_BUFFER_SIZE    (1024 * 1024)
+
+/* Nonzero if files and variables are written in order of their names,
+   rather than in the order they are found in make's tables.  */
+
+int dump_sorted = 0;
+
+static FILE *dump_out;
+static char *buffer;
+static size_t buflen;
+static size_t bufsize;
+
+/* Nonzero if the next member needs a comma before it.  */
+
+static int need_comma;
+
+static void
+dump_flush (void)
+{
+  if (buflen > 0)
+    fwrite (buffer, 1, buflen, dump_out);
+  buflen = 0;
+}
+
+static void
+append (const char *s, size_t len)
+{
+  if (buflen + len > bufsize)
+    {
+      if (dump_out != stdout)
+        {
+          bufsize = (buflen + len) * 2;
+          buffer = xrealloc (buffer, bufsize);
+        }
+      else
+        {
+          dump_flush ();
+          if (len > bufsize)
+            {
+              fwrite (s, 1, len, dump_out);
+              return;
+            }
+        }
+    }
+  memcpy (buffer + buflen, s, len);
+  buflen += len;
+}
+
+#define append_str(_s)  append ((_s), strlen (_s))
+
+/* Return the length of the valid UTF-8 sequence at P, which ends before
+   END, or 0 if it is not one.  Overlong forms and surrogates are not
+   valid.  */
+
+static int
+utf8_length (const unsigned char *p, const unsigned char *end)
+{
+  unsigned char lo = 0x80, hi = 0xbf;
+  int len, i;
+
+  if (*p < 0xc2 || *p > 0xf4)
+    return 0;
+  else if (*p < 0xe0)
+    len = 2;
+  else if (*p < 0xf0)
+    {
+      len = 3;
+      if (*p == 0xe0)
+        lo = 0xa0;
+      else if (*p == 0xed)
+        hi = 0x9f;
+    }
+  else
+    {
+      len = 4;
+      if (*p == 0xf0)
+        lo = 0x90;
+      else if (*p == 0xf4)
+        hi = 0x8f;
+    }
+
+  if (end - p < len || p[1] < lo || p[1] > hi)
+    return 0;
+  for (i = 2; i < len; ++i)
+    if (p[i] < 0x80 || p[i] > 0xbf)
+      return 0;
+
+  return len;
+}
+
+/* A byte which is not part of valid UTF-8 would make the string invalid
+   JSON, so it is written as U+FFFD, the replacement character.  */
+
+void
+json_string (const char *s, size_t len,
+             void (*out) (const char *, size_t))
+{
+  const char *end = s + len;
+  const char *p;
+
+  out ("\"", 1);
+  for (p = s; p < end; ++p)
+    {
+      unsigned char c = *p;
+      char esc[7];
+
+      if (c >= 0x80)
+        {
+          int n = utf8_length ((const unsigned char *) p,
+                               (const unsigned char *) end);
+          if (n > 0)
+            {
+              p += n - 1;
+              continue;
+            }
+        }
+      else if (c != '"' && c != '\\' && c >= 0x20)
+        continue;
+
+      out (s, p - s);
+      s = p + 1;
+      switch (c)
+        {
+        case '"':  out ("\\\"", 2); break;
+        case '\\': out ("\\\\", 2); break;
+        case '\n': out ("\\n", 2);  break;
+        case '\t': out ("\\t", 2);  break;
+        case '\r': out ("\\r", 2);  break;
+        default:
+          if (c >= 0x80)
+            out ("\\ufffd", 6);
+          else
+            {
+              sprintf (esc, "\\u%04x", c);
+              out (esc, 6);
+            }
+          break;
+        }
+    }
+  out (s, p - s);
+  out ("\"", 1);
+}
+
+/* Start a new member called NAME, or a new array element if NAME is null.  */
+
+static void
+append_name (const char *name)
+{
+  if (need_comma)
+    append (",", 1);
+  need_comma = 1;
+
+  if (name)
+    {
+      json_string (name, strlen (name), append);
+      append (":", 1);
+    }
+}
+
+void
+dump_begin (FILE *out)
+{
+  dump_out = out;
+  if (buffer == 0)
+    {
+      bufsize = DUMP_BUFFER_SIZE;
+      buffer = xmalloc (bufsize);
+    }
+
+  /* Anything already written to stdout must come first.  */
+  fflush (stdout);
+
+  append ("{", 1);
+  need_comma = 0;
+}
+
+void
+dump_end (void)
+{
+  append ("}\n", 2);
+  dump_flush ();
+  fflush (dump_out);
+}
+
+/* Call MAP for each item in the hash table HT, in the order given by
+   COMPARE if dump_sorted is set.  */
+
+void
+dump_table (struct hash_table *ht, void (*map) (const void *),
+            int (*compare) (const void *, const void *))
+{
+  void **items;
+  void **ip;
+
+  if (!dump_sorted)
+    {
+      hash_map (ht, map);
+      return;
+    }
+
+  items = hash_dump (ht, 0, compare);
+  for (ip = items; *ip != 0; ++ip)
+    map (*ip);
+  free (items);
+}
+
+void
+dump_begin_object (const char *name)
+{
+  append_name (name);
+  append ("{", 1);
+  need_comma = 0;
+}
+
+void
+dump_end_object (void)
+{
+  append ("}", 1);
+  need_comma = 1;
+}
+
+void
+dump_begin_array (const char *name)
+{
+  append_name (name);
+  append ("[", 1);
+  need_comma = 0;
+}
+
+void
+dump_end_array (void)
+{
+  append ("]", 1);
+  need_comma = 1;
+}
+
+void
+dump_str (const char *name, const char *value)
+{
+  append_name (name);
+  json_string (value, strlen (value), append);
+}
+
+void
+dump_strn (const char *name, const char *value, size_t len)
+{
+  append_name (name);
+  json_string (value, len, append);
+}
+
+void
+dump_uint (const char *name, unsigned long value)
+{
+  char num[INTSTR_LENGTH + 1];
+
+  append_name (name);
+  sprintf (num, "%lu", value);
+  append_str (num);
+}
+
+void
+dump_bool (const char *name, int value)
+{
+  append_name (name);
+  append_str (value ? "true" : "false");
+}
+
+/* Add VALUE, which is already formatted as a JSON number.  */
+
+void
+dump_number (const char *name, const char *value)
+{
+  append_name (name);
+  append_str (value);
+}
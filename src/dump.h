@@ -0,0 +1,46 @@
+/* Machine-readable dump of the data base for GNU Make.
+Copyright (C) 2020 Free Software Foundation, Inc.
+This file is part of GNU Make.
+
+GNU Make is free software; you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or (at your option) any later
+version.
+
+GNU Make is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/* The data base is written to a stream as a single JSON object on one line.
+   Start it with dump_begin() and finish it with dump_end().  Members are
+   added with the functions below; NAME is the member name, or null for an
+   element of an array.  */
+
+struct hash_table;
+
+extern int dump_sorted;
+
+void dump_begin (FILE *out);
+void dump_end (void);
+
+void dump_table (struct hash_table *ht, void (*map) (const void *),
+                 int (*compare) (const void *, const void *));
+
+void dump_begin_object (const char *name);
+void dump_end_object (void);
+void dump_begin_array (const char *name);
+void dump_end_array (void);
+
+void dump_str (const char *name, const char *value);
+void dump_strn (const char *name, const char *value, size_t len);
+void dump_uint (const char *name, unsigned long value);
+void dump_bool (const char *name, int value);
+void dump_number (const char *name, const char *value);
+
+/* Write the LEN bytes at S as a JSON string, quotes included, using OUT.  */
+
+void json_string (const char *s, size_t len,
+                  void (*out) (const char *, size_t));
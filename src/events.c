@@ -0,0 +1,315 @@
+/* Machine-readable stream of build events for GNU Make.
+Copyright (C) 2020 Free Software Foundation, Inc.
+This file is part of GNU Make.
+
+GNU Make is free software; you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or (at your option) any later
+version.
+
+GNU Make is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#include "makeint.h"
+
+#include "dump.h"
+#include "events.h"
+#include "os.h"
+
+#ifdef HAVE_FCNTL_H
+# include <fcntl.h>
+#else
+# include <sys/file.h>
+#endif
+
+#if defined(HAVE_PSELECT) && defined(HAVE_SYS_SELECT_H)
+# include <sys/select.h>
+#endif
+
+#ifndef PIPE_BUF
+# define PIPE_BUF 512
+#endif
+
+/* Events are collected in a buffer and written out a line at a time, and
+   only when the descriptor can take them without blocking, so a slow reader
+   at the other end of a pipe doesn't hold up the build.  If the reader
+   falls too far behind we wait for it rather than use unbounded memory.  */
+
+#define EVENTS_BUFFER_MAX   (1024 * 1024)
+
+int events_fd = -1;
+
+/* Nonzero if events_fd is a regular file, which never blocks.  */
+
+static int events_regular;
+
+/* Nonzero if we opened events_fd ourselves.  */
+
+static int events_owned;
+
+static char *buffer;
+static size_t buflen;
+static size_t bufsize;
+
+static void
+append (const char *s, size_t len)
+{
+  if (buflen + len > bufsize)
+    {
+      bufsize = (buflen + len) * 2 + 256;
+      buffer = xrealloc (buffer, bufsize);
+    }
+  memcpy (buffer + buflen, s, len);
+  buflen += len;
+}
+
+#define append_str(_s)  append ((_s), strlen (_s))
+
+/* Append S as a JSON string.  */
+
+#define append_json(_s)  json_string ((_s), strlen (_s), append)
+
+/* Return nonzero if the events descriptor can be written without blocking.
+   Without pselect() we can't tell, so we always assume it can.  */
+
+static int
+writable (void)
+{
+#if defined(HAVE_PSELECT)
+  fd_set fds;
+  struct timespec zero;
+  int r;
+
+  FD_ZERO (&fds);
+  FD_SET (events_fd, &fds);
+  zero.tv_sec = 0;
+  zero.tv_nsec = 0;
+  EINTRLOOP (r, pselect (events_fd + 1, NULL, &fds, NULL, &zero, NULL));
+  return r != 0;
+#else
+  return 1;
+#endif
+}
+
+/* Stop writing events, throwing away any we haven't written yet.  */
+
+static void
+events_stop (void)
+{
+  /* A descriptor we were given belongs to our parent; leave it open.  */
+  if (events_owned)
+    close (events_fd);
+  events_fd = -1;
+  events_owned = 0;
+  buflen = 0;
+}
+
+/* Write out as much of the buffer as possible.  If BLOCK is zero, stop as
+   soon as writing more would block.  */
+
+void
+events_flush (int block)
+{
+  size_t done = 0;
+
+  if (!EVENTS_ENABLED)
+    return;
+
+  while (done < buflen)
+    {
+      size_t len = buflen - done;
+      ssize_t r;
+
+      if (!block && !events_regular)
+        {
+          /* A write of no more than PIPE_BUF bytes to a writable pipe
+             doesn't block and isn't mixed up with other writers, so write
+             the whole lines that fit.  */
+          const char *start = buffer + done;
+          const char *nl;
+
+          if (!writable ())
+            break;
+
+          if (len > PIPE_BUF)
+            len = PIPE_BUF;
+          for (nl = start + len; nl > start && nl[-1] != '\n'; --nl)
+            ;
+          if (nl > start)
+            len = nl - start;
+          else
+            len = (const char *) memchr (start, '\n', buflen - done)
+              - start + 1;
+        }
+
+      EINTRLOOP (r, write (events_fd, buffer + done, len));
+      if (r < 0)
+        {
+          perror_with_name ("write: ", "--events");
+          events_stop ();
+          return;
+        }
+      done += r;
+    }
+
+  buflen -= done;
+  memmove (buffer, buffer + done, buflen);
+}
+
+/* Open the events stream described by *SPEC: either "fd:N" for a descriptor
+   make has inherited, or the name of a file.  A relative file name is made
+   absolute in *SPEC, so sub-makes find the same file.  The file is emptied
+   by the top-level make only; everyone else appends to it.  */
+
+void
+events_open (char **spec, unsigned int restarts)
+{
+  struct stat st;
+  int r;
+
+  if (EVENTS_ENABLED)
+    return;
+
+  if (strneq (*spec, "fd:", 3))
+    {
+      char *end;
+      long fd = strtol (*spec + 3, &end, 10);
+
+      if (end == *spec + 3 || *end != '\0' || fd < 0 || fd > INT_MAX)
+        OS (fatal, NILF, _("invalid --events descriptor '%s'"), *spec);
+
+      EINTRLOOP (r, fstat ((int) fd, &st));
+      if (r < 0)
+        OS (fatal, NILF, _("invalid --events descriptor '%s'"), *spec);
+
+      events_fd = (int) fd;
+    }
+  else
+    {
+      int flags = O_WRONLY | O_CREAT | O_APPEND;
+
+      if ((*spec)[0] != '/'
+          && starting_directory && starting_directory[0] != '\0'
+#ifdef HAVE_DOS_PATHS
+          && (*spec)[0] != '\\' && (*spec)[1] != ':'
+#endif
+          )
+        *spec = xstrdup (concat (3, starting_directory, "/", *spec));
+
+      if (makelevel == 0 && restarts == 0)
+        flags |= O_TRUNC;
+
+      EINTRLOOP (events_fd, open (*spec, flags, 0666));
+      if (events_fd < 0)
+        {
+          perror_with_name ("open: ", *spec);
+          return;
+        }
+      fd_noinherit (events_fd);
+      events_owned = 1;
+
+      EINTRLOOP (r, fstat (events_fd, &st));
+      if (r < 0)
+        st.st_mode = 0;
+    }
+
+  events_regular = S_ISREG (st.st_mode);
+
+#if defined(HAVE_PSELECT)
+  /* writable() can't wait on a descriptor that doesn't fit in an fd_set.  */
+  if (!events_regular && events_fd >= FD_SETSIZE)
+    OS (fatal, NILF, _("--events descriptor for '%s' is too large"), *spec);
+#endif
+}
+
+/* Write out whatever is left and stop writing events.  */
+
+void
+events_close (void)
+{
+  if (!EVENTS_ENABLED)
+    return;
+
+  events_flush (1);
+  if (EVENTS_ENABLED)
+    events_stop ();
+}
+
+void
+event_begin (const char *type)
+{
+  char num[64];
+#if HAVE_GETTIMEOFDAY
+  struct timeval tv;
+
+  if (gettimeofday (&tv, 0) != 0)
+    {
+      tv.tv_sec = time (NULL);
+      tv.tv_usec = 0;
+    }
+  sprintf (num, "%lu.%06lu", (unsigned long) tv.tv_sec,
+           (unsigned long) tv.tv_usec);
+#else
+  sprintf (num, "%lu", (unsigned long) time (NULL));
+#endif
+
+  append_str ("{\"event\":");
+  append_json (type);
+  append_str (",\"time\":");
+  append_str (num);
+  event_int ("pid", (long) getpid ());
+  event_int ("level", makelevel);
+}
+
+static void
+append_name (const char *name)
+{
+  append (",", 1);
+  append_json (name);
+  append (":", 1);
+}
+
+void
+event_str (const char *name, const char *value)
+{
+  append_name (name);
+  append_json (value);
+}
+
+void
+event_int (const char *name, long value)
+{
+  char num[INTSTR_LENGTH + 1];
+
+  append_name (name);
+  sprintf (num, "%ld", value);
+  append_str (num);
+}
+
+void
+event_bool (const char *name, int value)
+{
+  append_name (name);
+  append_str (value ? "true" : "false");
+}
+
+void
+event_num (const char *name, double value)
+{
+  char num[64];
+
+  append_name (name);
+  sprintf (num, "%.6f", value);
+  append_str (num);
+}
+
+void
+event_end (void)
+{
+  append ("}\n", 2);
+  events_flush (buflen > EVENTS_BUFFER_MAX);
+}
@@ -0,0 +1,36 @@
+/* Machine-readable stream of build events for GNU Make.
+Copyright (C) 2020 Free Software Foundation, Inc.
+This file is part of GNU Make.
+
+GNU Make is free software; you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or (at your option) any later
+version.
+
+GNU Make is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/* The descriptor events are written to, or -1 if --events was not given.  */
+
+extern int events_fd;
+
+#define EVENTS_ENABLED  (events_fd >= 0)
+
+void events_open (char **spec, unsigned int restarts);
+void events_flush (int block);
+void events_close (void);
+
+/* An event is written as a single JSON object on a line of its own.  Start
+   it with event_begin(), add its members, and finish it with event_end().
+   Every event has "event", "time", "pid" and "level" members.  */
+
+void event_begin (const char *type);
+void event_str (const char *name, const char *value);
+void event_int (const char *name, long value);
+void event_bool (const char *name, int value);
+void event_num (const char *name, double value);
+void event_end (void);
@@ -19,6 +19,8 @@ this program.  If not, see <http://www.gnu.org/licenses/>.  */
 #include <assert.h>
 
 #include "filedef.h"
+#include "debug.h"
+#include "hash.h"
 #include "job.h"
 #include "commands.h"
 #include "variable.h"
@@ -89,12 +91,15 @@ initialize_variable_output ()
   return variable_buffer;
 }
 
-/* Recursively expand V.  The returned string is malloc'd.  */
-
 static char *allocated_variable_append (const struct variable *v);
 
-char *
-recursively_expand_for_file (struct variable *v, struct file *file)
+/* Recursively expand V in the context of FILE.  If O is not NULL the
+   expansion is spliced directly into the variable buffer at O and a pointer
+   to the end of it is returned; this avoids building the value in a buffer
+   of its own and then copying it.  If O is NULL the result is malloc'd.  */
+
+static char *
+expand_recursive_variable_1 (char *o, struct variable *v, struct file *file)
 {
   char *value;
   const floc *this_var;
@@ -136,7 +141,17 @@ recursively_expand_for_file (struct variable *v, struct file *file)
 
   v->expanding = 1;
   if (v->append)
-    value = allocated_variable_append (v);
+    {
+      value = allocated_variable_append (v);
+      if (o)
+        {
+          o = variable_buffer_output (o, value, strlen (value));
+          free (value);
+          value = o;
+        }
+    }
+  else if (o)
+    value = variable_expand_output (o, v->value, SIZE_MAX);
   else
     value = allocated_variable_expand (v->value);
   v->expanding = 0;
@@ -152,6 +167,32 @@ recursively_expand_for_file (struct variable *v, struct file *file)
   return value;
 }
 
+static char *
+expand_recursive_variable (char *o, struct variable *v, struct file *file)
+{
+  char *value;
+  size_t off;
+
+  if (! ISDB (DB_PROFILE))
+    return expand_recursive_variable_1 (o, v, file);
+
+  off = o ? o - variable_buffer : 0;
+  expand_profile_enter (v->name, 'v');
+  value = expand_recursive_variable_1 (o, v, file);
+  expand_profile_leave (o ? (size_t) (value - (variable_buffer + off))
+                        : strlen (value));
+
+  return value;
+}
+
+/* Recursively expand V.  The returned string is malloc'd.  */
+
+char *
+recursively_expand_for_file (struct variable *v, struct file *file)
+{
+  return expand_recursive_variable (NULL, v, file);
+}
+
 /* Expand a simple reference to variable NAME, which is LENGTH chars long.  */
 
 #ifdef __GNUC__
@@ -161,10 +202,11 @@ static char *
 reference_variable (char *o, const char *name, size_t length)
 {
   struct variable *v;
-  char *value;
 
   v = lookup_variable (name, length);
 
+  STATS_COUNT (variable_refs);
+
   if (v == 0)
     warn_undefined (name, length);
 
@@ -172,44 +214,27 @@ reference_variable (char *o, const char *name, size_t length)
   if (v == 0 || (*v->value == '\0' && !v->append))
     return o;
 
-  value = (v->recursive ? recursively_expand (v) : v->value);
-
-  o = variable_buffer_output (o, value, strlen (value));
-
+  /* Expand recursive variables in place rather than copying the result.  */
   if (v->recursive)
-    free (value);
+    return expand_recursive_variable (o, v, NULL);
 
-  return o;
+  return variable_buffer_output (o, v->value, strlen (v->value));
 }
 
 /* Scan STRING for variable references and expansion-function calls.  Only
    LENGTH bytes of STRING are actually scanned.  If LENGTH is -1, scan until
    a null byte is found.
 
-   Write the results to LINE, which must point into 'variable_buffer'.  If
-   LINE is NULL, start at the beginning of the buffer.
-   Return a pointer to LINE, or to the beginning of the buffer if LINE is
-   NULL.
+   Write the results to the variable buffer starting at O, which must point
+   into 'variable_buffer'.  The result is null-terminated; return a pointer
+   to the terminating null byte.
  */
-char *
-variable_expand_string (char *line, const char *string, size_t length)
+static char *
+expand_string_output (char *o, const char *string, size_t length)
 {
   struct variable *v;
   const char *p, *p1;
   char *save;
-  char *o;
-  size_t line_offset;
-
-  if (!line)
-    line = initialize_variable_output ();
-  o = line;
-  line_offset = line - variable_buffer;
-
-  if (length == 0)
-    {
-      variable_buffer_output (o, "", 1);
-      return variable_buffer;
-    }
 
   /* We need a copy of STRING: due to eval, it's possible that it will get
      freed as we process it (it might be the value of a variable that's reset
@@ -225,7 +250,7 @@ variable_expand_string (char *line, const char *string, size_t length)
 
       p1 = strchr (p, '$');
 
-      o = variable_buffer_output (o, p, p1 != 0 ? (size_t) (p1 - p) : strlen (p) + 1);
+      o = variable_buffer_output (o, p, p1 != 0 ? (size_t) (p1 - p) : strlen (p));
 
       if (p1 == 0)
         break;
@@ -403,9 +428,53 @@ variable_expand_string (char *line, const char *string, size_t length)
 
   free (save);
 
-  variable_buffer_output (o, "", 1);
+  /* Some functions (e.g., sort) scan one byte past the end of an expanded
+     argument, so leave an extra null byte there.  */
+  o = variable_buffer_output (o, "\0", 2);
+  return o - 2;
+}
+
+/* Scan STRING for variable references and expansion-function calls.  Only
+   LENGTH bytes of STRING are actually scanned.  If LENGTH is -1, scan until
+   a null byte is found.
+
+   Write the results to LINE, which must point into 'variable_buffer'.  If
+   LINE is NULL, start at the beginning of the buffer.
+   Return a pointer to LINE, or to the beginning of the buffer if LINE is
+   NULL.
+ */
+char *
+variable_expand_string (char *line, const char *string, size_t length)
+{
+  size_t line_offset;
+
+  if (!line)
+    line = initialize_variable_output ();
+  line_offset = line - variable_buffer;
+
+  if (length == 0)
+    {
+      variable_buffer_output (line, "", 1);
+      return variable_buffer;
+    }
+
+  expand_string_output (line, string, length);
   return (variable_buffer + line_offset);
 }
+
+/* Like variable_expand_string, but return a pointer to the end of the
+   expanded text rather than to its beginning.  Expansion functions use this
+   to splice nested expansions directly into the output at O, instead of
+   expanding them into a separate buffer and copying the result back.  */
+
+char *
+variable_expand_output (char *o, const char *string, size_t length)
+{
+  if (length == 0)
+    return variable_buffer_output (o, "\0", 2) - 2;
+
+  return expand_string_output (o, string, length);
+}
 
 /* Scan LINE for variable references and expansion-function calls.
    Build in 'variable_buffer' the result of expanding the references and calls.
@@ -523,8 +592,7 @@ variable_append (const char *name, size_t length,
   if (! v->recursive)
     return variable_buffer_output (buf, v->value, strlen (v->value));
 
-  buf = variable_expand_string (buf, v->value, strlen (v->value));
-  return (buf + strlen (buf));
+  return variable_expand_output (buf, v->value, SIZE_MAX);
 }
 
 
@@ -572,6 +640,13 @@ allocated_variable_expand_for_file (const char *line, struct file *file)
   return value;
 }
 
+/* A buffer released by restore_variable_buffer, kept for the next call to
+   install_variable_buffer.  Every $(eval ...) installs a buffer of its own;
+   reusing one avoids allocating it and growing it again each time.  */
+
+static char *spare_buffer;
+static size_t spare_buffer_length;
+
 /* Install a new variable_buffer context, returning the current one for
    safe-keeping.  */
 
@@ -581,18 +656,233 @@ install_variable_buffer (char **bufp, size_t *lenp)
   *bufp = variable_buffer;
   *lenp = variable_buffer_length;
 
-  variable_buffer = 0;
-  initialize_variable_output ();
+  if (spare_buffer)
+    {
+      variable_buffer = spare_buffer;
+      variable_buffer_length = spare_buffer_length;
+      variable_buffer[0] = '\0';
+      spare_buffer = 0;
+    }
+  else
+    {
+      variable_buffer = 0;
+      initialize_variable_output ();
+    }
 }
 
-/* Restore a previously-saved variable_buffer setting (free the current one).
- */
+/* Restore a previously-saved variable_buffer setting (free the current one,
+   or keep it for reuse).  */
 
 void
 restore_variable_buffer (char *buf, size_t len)
 {
-  free (variable_buffer);
+  if (!spare_buffer || variable_buffer_length > spare_buffer_length)
+    {
+      free (spare_buffer);
+      spare_buffer = variable_buffer;
+      spare_buffer_length = variable_buffer_length;
+    }
+  else
+    free (variable_buffer);
 
   variable_buffer = buf;
   variable_buffer_length = len;
 }
+
+/* Expansion profiling (--debug=expand).  For every variable, builtin
+   function and user-defined function that is expanded we count the number of
+   expansions, the time spent in them both including and excluding nested
+   expansions, and the number of bytes they produced.  */
+
+struct expand_profile
+  {
+    const char *name;           /* Name of the variable or function.  */
+    char kind;                  /* 'v'ariable, 'f'unction or 'u'ser func.  */
+    unsigned int active;        /* Number of frames on the stack for this.  */
+    unsigned long calls;        /* Number of expansions.  */
+    unsigned long bytes;        /* Bytes of output produced.  */
+    double inclusive;           /* Seconds, including nested expansions.  */
+    double exclusive;           /* Seconds, excluding nested expansions.  */
+  };
+
+struct expand_profile_frame
+  {
+    struct expand_profile *profile;
+    double start;               /* Time this expansion started.  */
+    double nested;              /* Time spent in nested expansions.  */
+  };
+
+#define EXPAND_PROFILE_BUCKETS  1024
+
+static struct hash_table expand_profile_table;
+static struct expand_profile_frame *profile_stack;
+static unsigned int profile_depth;
+static unsigned int profile_max;
+
+static unsigned long
+expand_profile_hash_1 (const void *key)
+{
+  const struct expand_profile *p = key;
+  unsigned long result = p->kind;
+  STRING_HASH_1 (p->name, result);
+  return result;
+}
+
+static unsigned long
+expand_profile_hash_2 (const void *key)
+{
+  return_STRING_HASH_2 (((const struct expand_profile *) key)->name);
+}
+
+static int
+expand_profile_hash_cmp (const void *x, const void *y)
+{
+  const struct expand_profile *px = x;
+  const struct expand_profile *py = y;
+  if (px->kind != py->kind)
+    return px->kind - py->kind;
+  return_STRING_COMPARE (px->name, py->name);
+}
+
+/* Start timing an expansion of NAME, which is of type KIND.  Every call must
+   be matched by a call to expand_profile_leave().  */
+
+void
+expand_profile_enter (const char *name, char kind)
+{
+  struct expand_profile key;
+  struct expand_profile **slot;
+  struct expand_profile *prof;
+  struct expand_profile_frame *frame;
+
+  if (! expand_profile_table.ht_vec)
+    hash_init (&expand_profile_table, EXPAND_PROFILE_BUCKETS,
+               expand_profile_hash_1, expand_profile_hash_2,
+               expand_profile_hash_cmp);
+
+  key.name = name;
+  key.kind = kind;
+  slot = (struct expand_profile **) hash_find_slot (&expand_profile_table,
+                                                    &key);
+  prof = *slot;
+  if (HASH_VACANT (prof))
+    {
+      prof = xcalloc (sizeof (struct expand_profile));
+      prof->name = strcache_add (name);
+      prof->kind = kind;
+      hash_insert_at (&expand_profile_table, prof, slot);
+    }
+
+  if (profile_depth == profile_max)
+    {
+      profile_max = profile_max ? profile_max * 2 : 64;
+      profile_stack = xrealloc (profile_stack,
+                                profile_max * sizeof (*profile_stack));
+    }
+
+  ++prof->calls;
+  ++prof->active;
+
+  frame = &profile_stack[profile_depth++];
+  frame->profile = prof;
+  frame->nested = 0;
+  frame->start = clock_seconds ();
+}
+
+/* Finish timing the most recently started expansion, which produced BYTES
+   bytes of output.  */
+
+void
+expand_profile_leave (size_t bytes)
+{
+  struct expand_profile_frame *frame = &profile_stack[--profile_depth];
+  struct expand_profile *prof = frame->profile;
+  double elapsed = clock_seconds () - frame->start;
+
+  prof->exclusive += elapsed - frame->nested;
+  prof->bytes += bytes;
+
+  /* If this expansion is nested inside another of the same name, the outer
+     one already accounts for this time.  */
+  if (--prof->active == 0)
+    prof->inclusive += elapsed;
+
+  if (profile_depth)
+    profile_stack[profile_depth - 1].nested += elapsed;
+}
+
+static int
+expand_profile_compare (const void *x, const void *y)
+{
+  const struct expand_profile *px = *(const struct expand_profile **) x;
+  const struct expand_profile *py = *(const struct expand_profile **) y;
+
+  if (px->inclusive != py->inclusive)
+    return px->inclusive < py->inclusive ? 1 : -1;
+  if (px->calls != py->calls)
+    return px->calls < py->calls ? 1 : -1;
+  return strcmp (px->name, py->name);
+}
+
+static const char *
+expand_profile_kind (char kind)
+{
+  switch (kind)
+    {
+    case 'v':
+      return "variable";
+    case 'f':
+      return "function";
+    default:
+      return "call";
+    }
+}
+
+/* Print the expansion profile, most expensive first.  If DUMPFILE is not
+   NULL, also write it there as tab-separated values.  */
+
+void
+print_expand_profile (const char *dumpfile)
+{
+  struct expand_profile **entries;
+  struct expand_profile **epp;
+  FILE *dump = NULL;
+
+  if (! expand_profile_table.ht_vec)
+    return;
+
+  entries = (struct expand_profile **) hash_dump (&expand_profile_table, 0,
+                                                   expand_profile_compare);
+
+  if (dumpfile)
+    {
+      dump = fopen (dumpfile, "w");
+      if (!dump)
+        perror_with_name ("fopen: ", dumpfile);
+      else
+        fputs ("kind\tname\tcalls\tinclusive\texclusive\tbytes\n", dump);
+    }
+
+  puts (_("\n# Expansion profile (times in milliseconds)"));
+  printf ("# %10s %12s %12s %12s  %-8s  %s\n", _("calls"), _("inclusive"),
+          _("exclusive"), _("bytes"), _("kind"), _("name"));
+
+  for (epp = entries; *epp; ++epp)
+    {
+      const struct expand_profile *p = *epp;
+      const char *kind = expand_profile_kind (p->kind);
+
+      printf ("  %10lu %12.3f %12.3f %12lu  %-8s  %s\n", p->calls,
+              p->inclusive * 1000, p->exclusive * 1000, p->bytes, kind,
+              p->name);
+      if (dump)
+        fprintf (dump, "%s\t%s\t%lu\t%.9f\t%.9f\t%lu\n", kind, p->name,
+                 p->calls, p->inclusive, p->exclusive, p->bytes);
+    }
+
+  if (dump)
+    fclose (dump);
+
+  free (entries);
+  fflush (stdout);
+}
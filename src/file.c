@@ -25,6 +25,7 @@ this program.  If not, see <http://www.gnu.org/licenses/>.  */
 #include "variable.h"
 #include "debug.h"
 #include "hash.h"
+#include "dump.h"
 
 
 /* Remember whether snap_deps has been invoked: we need this to be sure we
@@ -330,6 +331,8 @@ rehash_file (struct file *from_file, const char *to_hname)
 
 #define MERGE(field) to_file->field |= from_file->field
   MERGE (precious);
+  MERGE (cacheable);
+  MERGE (notparallel);
   MERGE (tried_implicit);
   MERGE (updating);
   MERGE (updated);
@@ -475,7 +478,36 @@ split_prereqs (char *p)
         ood->ignore_mtime = 1;
     }
 
-  return new;
+  return strip_wait_prereqs (new);
+}
+
+/* Remove the .WAIT pseudo-prerequisites from the list DEPS.  The
+   prerequisite following each one is marked, so that it is not started
+   until all the prerequisites before it are complete.  */
+struct dep *
+strip_wait_prereqs (struct dep *deps)
+{
+  struct dep **dp = &deps;
+  int wait = 0;
+
+  while (*dp != 0)
+    {
+      struct dep *d = *dp;
+
+      if (d->name != 0 && streq (d->name, ".WAIT"))
+        {
+          *dp = d->next;
+          free_dep (d);
+          wait = 1;
+          continue;
+        }
+
+      d->wait_here |= wait;
+      wait = 0;
+      dp = &d->next;
+    }
+
+  return deps;
 }
 
 /* Given a list of prerequisites, enter them into the file database.
@@ -633,6 +665,7 @@ expand_deps (struct file *f)
         }
 
       /* Add newly parsed prerequisites.  */
+      new->wait_here |= d->wait_here;
       next = d->next;
       *dp = new;
       for (dp = &new->next, d = new->next; d != 0; dp = &d->next, d = d->next)
@@ -770,6 +803,11 @@ snap_deps (void)
       for (f2 = d->file; f2 != 0; f2 = f2->prev)
         f2->precious = 1;
 
+  for (f = lookup_file (".CACHEABLE"); f != 0; f = f->prev)
+    for (d = f->deps; d != 0; d = d->next)
+      for (f2 = d->file; f2 != 0; f2 = f2->prev)
+        f2->cacheable = 1;
+
   for (f = lookup_file (".LOW_RESOLUTION_TIME"); f != 0; f = f->prev)
     for (d = f->deps; d != 0; d = d->next)
       for (f2 = d->file; f2 != 0; f2 = f2->prev)
@@ -865,7 +903,14 @@ snap_deps (void)
 
   f = lookup_file (".NOTPARALLEL");
   if (f != 0 && f->is_target)
-    not_parallel = 1;
+    {
+      if (f->deps == 0)
+        not_parallel = 1;
+      else
+        for (d = f->deps; d != 0; d = d->next)
+          for (f2 = d->file; f2 != 0; f2 = f2->prev)
+            f2->notparallel = 1;
+    }
 
   {
     struct dep *prereqs = expand_extra_prereqs (lookup_variable (STRING_SIZE_TUPLE(".EXTRA_PREREQS")));
@@ -1016,17 +1061,17 @@ print_prereqs (const struct dep *deps)
   /* Print all normal dependencies; note any order-only deps.  */
   for (; deps != 0; deps = deps->next)
     if (! deps->ignore_mtime)
-      printf (" %s", dep_name (deps));
+      printf ("%s %s", deps->wait_here ? " .WAIT" : "", dep_name (deps));
     else if (! ood)
       ood = deps;
 
   /* Print order-only deps, if we have any.  */
   if (ood)
     {
-      printf (" | %s", dep_name (ood));
+      printf (" |%s %s", ood->wait_here ? " .WAIT" : "", dep_name (ood));
       for (ood = ood->next; ood != 0; ood = ood->next)
         if (ood->ignore_mtime)
-          printf (" %s", dep_name (ood));
+          printf ("%s %s", ood->wait_here ? " .WAIT" : "", dep_name (ood));
     }
 
   putchar ('\n');
@@ -1065,6 +1110,10 @@ print_file (const void *item)
 
   if (f->precious)
     puts (_("#  Precious file (prerequisite of .PRECIOUS)."));
+  if (f->cacheable)
+    puts (_("#  Cacheable file (prerequisite of .CACHEABLE)."));
+  if (f->notparallel)
+    puts (_("#  Serial prerequisites (prerequisite of .NOTPARALLEL)."));
   if (f->phony)
     puts (_("#  Phony target (prerequisite of .PHONY)."));
   if (f->cmd_target)
@@ -1155,6 +1204,163 @@ print_file_data_base (void)
   fputs (_("\n# files hash-table stats:\n# "), stdout);
   hash_print_stats (&files, stdout);
 }
+
+/* Write the prerequisites DEPS for --print-data-base=json.  A .WAIT in the
+   list is written where it appears.  */
+
+void
+dump_prereqs (const struct dep *deps)
+{
+  const struct dep *d;
+  int ood = 0;
+
+  dump_begin_array ("prerequisites");
+  for (d = deps; d != 0; d = d->next)
+    if (! d->ignore_mtime)
+      {
+        if (d->wait_here)
+          dump_str (0, ".WAIT");
+        dump_str (0, dep_name (d));
+      }
+    else
+      ood = 1;
+  dump_end_array ();
+
+  if (ood)
+    {
+      dump_begin_array ("order_only");
+      for (d = deps; d != 0; d = d->next)
+        if (d->ignore_mtime)
+          {
+            if (d->wait_here)
+              dump_str (0, ".WAIT");
+            dump_str (0, dep_name (d));
+          }
+      dump_end_array ();
+    }
+}
+
+/* Write one file for --print-data-base=json.  Only the flags which are set
+   are written.  */
+
+static void
+dump_file (const void *item)
+{
+  const struct file *f = item;
+
+  if (no_builtin_rules_flag && f->builtin)
+    return;
+
+  dump_begin_object (0);
+  dump_str ("name", f->name);
+  if (f->double_colon)
+    dump_bool ("double_colon", 1);
+  if (!f->is_target)
+    dump_bool ("target", 0);
+
+  dump_prereqs (f->deps);
+
+  if (f->also_make != 0)
+    {
+      const struct dep *d;
+      dump_begin_array ("also_make");
+      for (d = f->also_make; d != 0; d = d->next)
+        dump_str (0, dep_name (d));
+      dump_end_array ();
+    }
+
+#define DUMP_FLAG(_f)   do{ if (f->_f) dump_bool (#_f, 1); }while(0)
+  DUMP_FLAG (phony);
+  DUMP_FLAG (precious);
+  DUMP_FLAG (intermediate);
+  DUMP_FLAG (secondary);
+  DUMP_FLAG (cacheable);
+  DUMP_FLAG (notparallel);
+  DUMP_FLAG (cmd_target);
+  DUMP_FLAG (dontcare);
+  DUMP_FLAG (builtin);
+  DUMP_FLAG (tried_implicit);
+  DUMP_FLAG (updated);
+#undef DUMP_FLAG
+
+  if (f->stem != 0)
+    dump_str ("stem", f->stem);
+
+  if (f->last_mtime == NONEXISTENT_MTIME)
+    dump_bool ("exists", 0);
+  else if (f->last_mtime == OLD_MTIME)
+    dump_bool ("old", 1);
+  else if (f->last_mtime == NEW_MTIME)
+    dump_bool ("new", 1);
+  else if (f->last_mtime != UNKNOWN_MTIME)
+    {
+      char buf[INTSTR_LENGTH + 11];
+      time_t t = FILE_TIMESTAMP_S (f->last_mtime);
+
+      sprintf (buf, "%ld.%09d", (long) t, FILE_TIMESTAMP_NS (f->last_mtime));
+      dump_number ("mtime", buf);
+    }
+
+  if (f->command_state == cs_not_started || f->command_state == cs_finished)
+    switch (f->update_status)
+      {
+      case us_none:
+        break;
+      case us_success:
+        dump_str ("status", "success");
+        break;
+      case us_question:
+        dump_str ("status", "question");
+        break;
+      case us_failed:
+        dump_str ("status", "failed");
+        break;
+      }
+
+  if (f->variables != 0)
+    dump_target_variables (f);
+
+  if (f->cmds != 0)
+    dump_commands (f->cmds);
+
+  dump_end_object ();
+
+  if (f->prev)
+    dump_file (f->prev);
+}
+
+static int
+dump_file_compare (const void *x, const void *y)
+{
+  return strcmp ((*(const struct file **) x)->name,
+                 (*(const struct file **) y)->name);
+}
+
+void
+dump_file_data_base (void)
+{
+  dump_begin_array ("files");
+  dump_table (&files, dump_file, dump_file_compare);
+  dump_end_array ();
+}
+
+/* Print the statistics of the files hash table, for --stats.  */
+
+void
+print_file_stats (void)
+{
+  fputs (_("# files hash-table: "), stdout);
+  hash_print_stats (&files, stdout);
+  putc ('\n', stdout);
+}
+
+/* Call FUNC with ARG for each file in the data base.  */
+
+void
+map_files (hash_map_arg_func_t func, void *arg)
+{
+  hash_map_arg (&files, func, arg);
+}
 
 /* Verify the integrity of the data base of files.  */
 
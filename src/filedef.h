@@ -23,6 +23,7 @@ this program.  If not, see <http://www.gnu.org/licenses/>.  */
 
 struct commands;
 struct dep;
+struct pool;
 struct variable;
 struct variable_set_list;
 
@@ -52,6 +53,9 @@ struct file
        isn't one.  Also see the pat_searched flag, below.  */
     struct variable_set_list *pat_variables;
 
+    /* Resource pool its recipe is counted in, once pool_known is set.  */
+    struct pool *pool;
+
     /* Immediate dependent that caused this target to be remade,
        or nil if there isn't one.  */
     struct file *parent;
@@ -63,6 +67,8 @@ struct file
     FILE_TIMESTAMP last_mtime;  /* File's modtime, if already known.  */
     FILE_TIMESTAMP mtime_before_update; /* File's modtime before any updating
                                            has been performed.  */
+    FILE_TIMESTAMP hook_mtime;  /* Modtime from a timestamp hook, not yet
+                                   used.  */
     unsigned int considered;    /* equal to 'considered' if file has been
                                    considered on current scan of goal chain */
     int command_flags;          /* Flags OR'd in for cmds; see commands.h.  */
@@ -83,6 +89,10 @@ struct file
 
     unsigned int builtin:1;     /* True if the file is a builtin rule. */
     unsigned int precious:1;    /* Non-0 means don't delete file on quit */
+    unsigned int cacheable:1;   /* Nonzero if the results of its recipe may
+                                   be saved in and restored from the cache.  */
+    unsigned int notparallel:1; /* Nonzero if its prerequisites must be
+                                   updated one at a time.  */
     unsigned int loaded:1;      /* True if the file is a loaded object. */
     unsigned int low_resolution_time:1; /* Nonzero if this file's time stamp
                                            has only one-second resolution.  */
@@ -107,6 +117,14 @@ struct file
                                    pattern-specific variables.  */
     unsigned int no_diag:1;     /* True if the file failed to update and no
                                    diagnostics has been issued (dontcare). */
+    unsigned int mtime_hooked:1;/* Nonzero if the timestamp hooks have been
+                                   asked about this file.  */
+    unsigned int hook_uptodate:1;/* Nonzero if a timestamp hook said this
+                                   file is up to date.  */
+    unsigned int search_undone:1;/* Nonzero if implicit rule search entered
+                                   this file and --watch has since undone
+                                   the search.  */
+    unsigned int pool_known:1;  /* Nonzero if pool has been looked up.  */
   };
 
 
@@ -116,6 +134,7 @@ extern struct file *default_file;
 struct file *lookup_file (const char *name);
 struct file *enter_file (const char *name);
 struct dep *split_prereqs (char *prereqstr);
+struct dep *strip_wait_prereqs (struct dep *deps);
 struct dep *enter_prereqs (struct dep *prereqs, const char *stem);
 struct dep *expand_extra_prereqs (const struct variable *extra);
 void remove_intermediates (int sig);
@@ -129,7 +148,12 @@ void verify_file_data_base (void);
 char *build_target_list (char *old_list);
 void print_prereqs (const struct dep *deps);
 void print_file_data_base (void);
+void dump_prereqs (const struct dep *deps);
+void dump_file_data_base (void);
+void print_file_stats (void);
+void map_files (hash_map_arg_func_t func, void *arg);
 int try_implicit_rule (struct file *file, unsigned int depth);
+void note_implicit_search (struct file *file, int entered);
 int stemlen_compare (const void *v1, const void *v2);
 
 #if FILE_TIMESTAMP_HI_RES
@@ -184,6 +208,7 @@ void file_timestamp_sprintf (char *p, FILE_TIMESTAMP ts);
    The value is NONEXISTENT_MTIME if the file does not exist.  */
 #define file_mtime_no_search(f) file_mtime_1 ((f), 0)
 FILE_TIMESTAMP f_mtime (struct file *file, int search);
+void define_mtime_hook (const char *pattern, gmk_mtime_func_ptr func);
 #define file_mtime_1(f, v) \
   ((f)->last_mtime == UNKNOWN_MTIME ? f_mtime ((f), v) : (f)->last_mtime)
 
@@ -33,6 +33,7 @@ struct function_table_entry
     union {
       char *(*func_ptr) (char *output, char **argv, const char *fname);
       gmk_func_ptr alloc_func_ptr;
+      gmk_output_func_ptr output_func_ptr;
     } fptr;
     const char *name;
     unsigned char len;
@@ -40,6 +41,7 @@ struct function_table_entry
     unsigned char maximum_args;
     unsigned int expand_args:1;
     unsigned int alloc_fn:1;
+    unsigned int output_fn:1;
   };
 
 static unsigned long
@@ -884,17 +886,12 @@ func_foreach (char *o, char **argv, const char *funcname UNUSED)
   /* loop through LIST,  put the value in VAR and expand BODY */
   while ((p = find_next_token (&list_iterator, &len)) != 0)
     {
-      char *result = 0;
-
       free (var->value);
       var->value = xstrndup (p, len);
 
-      result = allocated_variable_expand (body);
-
-      o = variable_buffer_output (o, result, strlen (result));
+      o = variable_expand_output (o, body, SIZE_MAX);
       o = variable_buffer_output (o, " ", 1);
       doneany = 1;
-      free (result);
     }
 
   if (doneany)
@@ -949,13 +946,13 @@ func_let (char *o, char **argv, const char *funcname UNUSED)
   /* Expand the body in the context of the arguments, adding the result to
      the variable buffer.  */
 
-  o = variable_expand_string (o, body, SIZE_MAX);
+  o = variable_expand_output (o, body, SIZE_MAX);
 
   pop_variable_scope ();
   free (varnames);
   free (list);
 
-  return o + strlen (o);
+  return o;
 }
 
 struct a_word
@@ -1311,13 +1308,7 @@ func_if (char *o, char **argv, const char *funcname UNUSED)
   argv += 1 + !result;
 
   if (*argv)
-    {
-      char *expansion = expand_argument (*argv, NULL);
-
-      o = variable_buffer_output (o, expansion, strlen (expansion));
-
-      free (expansion);
-    }
+    o = variable_expand_output (o, *argv, SIZE_MAX);
 
   return o;
 }
@@ -1451,6 +1442,13 @@ func_eval (char *o, char **argv, const char *funcname UNUSED)
 {
   char *buf;
   size_t len;
+  const char *p = argv[0];
+
+  /* Templates often expand to nothing at all: don't bother parsing them.  */
+  while (ISSPACE (*p))
+    ++p;
+  if (*p == '\0')
+    return o;
 
   /* Eval the buffer.  Pop the current variable buffer setting so that the
      eval'd code can use its own without conflicting.  */
@@ -1833,13 +1831,20 @@ func_shell_base (char *o, char **argv, int trim_newlines)
 
   {
     struct childbase child;
+    double start;
     child.cmd_name = NULL;
     child.output.syncout = 1;
     child.output.out = pipedes[1];
     child.output.err = errfd;
     child.environment = envp;
 
+    start = clock_seconds ();
     pid = child_execute_job (&child, 1, command_argv);
+    if (pid > 0)
+      {
+        STATS_COUNT (shells);
+        stats_process_started (start);
+      }
 
     free (child.cmd_name);
   }
@@ -2401,7 +2406,7 @@ func_abspath (char *o, char **argv, const char *funcname UNUSED)
 static char *func_call (char *o, char **argv, const char *funcname);
 
 #define FT_ENTRY(_name, _min, _max, _exp, _func) \
-  { { (_func) }, STRING_SIZE_TUPLE(_name), (_min), (_max), (_exp), 0 }
+  { { (_func) }, STRING_SIZE_TUPLE(_name), (_min), (_max), (_exp), 0, 0 }
 
 static struct function_table_entry function_table_init[] =
 {
@@ -2469,13 +2474,29 @@ expand_builtin_function (char *o, int argc, char **argv,
      but so far no internal ones do, so just test it for all functions here
      rather than in each one.  We can change it later if necessary.  */
 
-  if (!argc && !entry_p->alloc_fn)
+  if (!argc && !entry_p->alloc_fn && !entry_p->output_fn)
     return o;
 
   if (!entry_p->fptr.func_ptr)
     OS (fatal, *expanding_var,
         _("unimplemented on this platform: function '%s'"), entry_p->name);
 
+  /* This function writes straight to the variable buffer.  */
+  if (entry_p->output_fn)
+    {
+      struct gmk_output out;
+      size_t *lens = alloca (sizeof (size_t) * (argc + 1));
+      int i;
+
+      for (i = 0; i < argc; ++i)
+        lens[i] = strlen (argv[i]);
+      lens[argc] = 0;
+
+      out.o = o;
+      entry_p->fptr.output_func_ptr (entry_p->name, argc, argv, lens, &out);
+      return out.o;
+    }
+
   if (!entry_p->alloc_fn)
     return entry_p->fptr.func_ptr (o, argv, entry_p->name);
 
@@ -2492,15 +2513,13 @@ expand_builtin_function (char *o, int argc, char **argv,
   return o;
 }
 
-/* Check for a function invocation in *STRINGP.  *STRINGP points at the
-   opening ( or { and is not null-terminated.  If a function invocation
-   is found, expand it into the buffer at *OP, updating *OP, incrementing
-   *STRINGP past the reference and returning nonzero.  If not, return zero.  */
+/* Expand the invocation of the builtin function ENTRY_P at *STRINGP into the
+   buffer at *OP, updating *OP and incrementing *STRINGP past the reference.  */
 
-int
-handle_function (char **op, const char **stringp)
+static void
+expand_function_call (const struct function_table_entry *entry_p,
+                      char **op, const char **stringp)
 {
-  const struct function_table_entry *entry_p;
   char openparen = (*stringp)[0];
   char closeparen = openparen == '(' ? ')' : '}';
   const char *beg;
@@ -2510,17 +2529,9 @@ handle_function (char **op, const char **stringp)
   char **argv, **argvp;
   int nargs;
 
-  beg = *stringp + 1;
-
-  entry_p = lookup_function (beg);
-
-  if (!entry_p)
-    return 0;
-
-  /* We found a builtin function.  Find the beginning of its arguments (skip
-     whitespace after the name).  */
+  /* Find the beginning of the arguments (skip whitespace after the name).  */
 
-  beg += entry_p->len;
+  beg = *stringp + 1 + entry_p->len;
   NEXT_TOKEN (beg);
 
   /* Find the end of the function invocation, counting nested use of
@@ -2609,6 +2620,33 @@ handle_function (char **op, const char **stringp)
       free (*argvp);
   else
     free (abeg);
+}
+
+/* Check for a function invocation in *STRINGP.  *STRINGP points at the
+   opening ( or { and is not null-terminated.  If a function invocation
+   is found, expand it into the buffer at *OP, updating *OP, incrementing
+   *STRINGP past the reference and returning nonzero.  If not, return zero.  */
+
+int
+handle_function (char **op, const char **stringp)
+{
+  const struct function_table_entry *entry_p = lookup_function (*stringp + 1);
+
+  if (!entry_p)
+    return 0;
+
+  STATS_COUNT (function_calls);
+
+  if (ISDB (DB_PROFILE))
+    {
+      size_t off = *op - variable_buffer;
+
+      expand_profile_enter (entry_p->name, 'f');
+      expand_function_call (entry_p, op, stringp);
+      expand_profile_leave (*op - (variable_buffer + off));
+    }
+  else
+    expand_function_call (entry_p, op, stringp);
 
   return 1;
 }
@@ -2700,20 +2738,31 @@ func_call (char *o, char **argv, const char *funcname UNUSED)
 
   saved_args = max_args;
   max_args = i;
-  o = variable_expand_string (o, body, flen+3);
+  if (ISDB (DB_PROFILE))
+    {
+      size_t off = o - variable_buffer;
+
+      expand_profile_enter (fname, 'u');
+      o = variable_expand_output (o, body, flen+3);
+      expand_profile_leave (o - (variable_buffer + off));
+    }
+  else
+    o = variable_expand_output (o, body, flen+3);
   max_args = saved_args;
 
   v->exp_count = 0;
 
   pop_variable_scope ();
 
-  return o + strlen (o);
+  return o;
 }
 
-void
-define_new_function (const floc *flocp, const char *name,
-                     unsigned int min, unsigned int max, unsigned int flags,
-                     gmk_func_ptr func)
+/* Check the definition of a new function and return a table entry for it,
+   which the caller must fill in and insert.  */
+
+static struct function_table_entry *
+new_function_entry (const floc *flocp, const char *name,
+                    unsigned int min, unsigned int max, unsigned int flags)
 {
   const char *e = name;
   struct function_table_entry *ent;
@@ -2742,12 +2791,40 @@ define_new_function (const floc *flocp, const char *name,
   ent->minimum_args = (unsigned char) min;
   ent->maximum_args = (unsigned char) max;
   ent->expand_args = ANY_SET(flags, GMK_FUNC_NOEXPAND) ? 0 : 1;
+  ent->alloc_fn = 0;
+  ent->output_fn = 0;
+
+  return ent;
+}
+
+void
+define_new_function (const floc *flocp, const char *name,
+                     unsigned int min, unsigned int max, unsigned int flags,
+                     gmk_func_ptr func)
+{
+  struct function_table_entry *ent;
+
+  ent = new_function_entry (flocp, name, min, max, flags);
   ent->alloc_fn = 1;
   ent->fptr.alloc_func_ptr = func;
 
   hash_insert (&function_table, ent);
 }
 
+void
+define_new_output_function (const floc *flocp, const char *name,
+                            unsigned int min, unsigned int max,
+                            unsigned int flags, gmk_output_func_ptr func)
+{
+  struct function_table_entry *ent;
+
+  ent = new_function_entry (flocp, name, min, max, flags);
+  ent->output_fn = 1;
+  ent->fptr.output_func_ptr = func;
+
+  hash_insert (&function_table, ent);
+}
+
 void
 hash_init_function_table (void)
 {
@@ -50,4 +50,4 @@
   (gmk-expand (format #f "$(~a)" (obj-to-str v))))
 
 ;; Export the public interfaces
-(export gmk-expand gmk-eval gmk-var)
+(export gmk-expand gmk-eval gmk-var gmk-add-function)
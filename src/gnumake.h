@@ -19,6 +19,9 @@ this program.  If not, see <http://www.gnu.org/licenses/>.  */
 #ifndef _GNUMAKE_H_
 #define _GNUMAKE_H_
 
+#include <stddef.h>
+#include <time.h>
+
 /* Specify the location of elements read from makefiles.  */
 typedef struct
   {
@@ -28,6 +31,43 @@ typedef struct
 
 typedef char *(*gmk_func_ptr)(const char *nm, unsigned int argc, char **argv);
 
+/* Where a function registered with gmk_add_output_function() writes its
+   result.  */
+typedef struct gmk_output gmk_output;
+
+typedef void (*gmk_output_func_ptr)(const char *nm, unsigned int argc,
+                                    char **argv, const size_t *lens,
+                                    gmk_output *out);
+
+/* A file (target or prerequisite) in GNU make's database.  */
+typedef struct file gmk_file;
+
+typedef int (*gmk_prereq_func)(gmk_file *prereq, unsigned int flags,
+                               void *arg);
+
+/* A question to a timestamp hook about one file, and its answer.  */
+typedef struct
+  {
+    const char *name;           /* The name of the file.  */
+    int status;                 /* Set by the hook: one of GMK_MTIME_*.  */
+    time_t sec;                 /* The timestamp, for GMK_MTIME_SET.  */
+    long nsec;
+  } gmk_mtime;
+
+typedef void (*gmk_mtime_func_ptr)(unsigned int count, gmk_mtime *files);
+
+/* A recipe that is about to be run, as shown to a job hook.  */
+typedef struct
+  {
+    const char *target;         /* The target being remade.  */
+    unsigned int ncommands;     /* The number of recipe lines.  */
+    const char **commands;      /* The expanded recipe lines.  */
+    char **envp;                /* The environment of the recipe.  */
+  } gmk_job;
+
+typedef int (*gmk_job_start_func_ptr)(const gmk_job *job);
+typedef void (*gmk_job_done_func_ptr)(const char *target, int status);
+
 #ifdef _WIN32
 # ifdef GMK_BUILDING_MAKE
 #  define GMK_EXPORT  __declspec(dllexport)
@@ -76,4 +116,107 @@ GMK_EXPORT void gmk_add_function (const char *name, gmk_func_ptr func,
 #define GMK_FUNC_DEFAULT    0x00
 #define GMK_FUNC_NOEXPAND   0x01
 
+/* Register a new GNU make function NAME, as with gmk_add_function(), whose
+   result is written directly into make's expansion buffer rather than
+   returned in allocated memory.
+
+   FUNC is passed the length of each argument in LENS, and appends its
+   result with gmk_output_add() on OUT.  OUT may not be used once FUNC
+   returns.  */
+GMK_EXPORT void gmk_add_output_function (const char *name,
+                                         gmk_output_func_ptr func,
+                                         unsigned int min_args,
+                                         unsigned int max_args,
+                                         unsigned int flags);
+
+/* Append LEN bytes of STR to the result OUT of a function.  */
+GMK_EXPORT void gmk_output_add (gmk_output *out, const char *str, size_t len);
+
+/* Return the file NAME in GNU make's database, or NULL if there is none.  */
+GMK_EXPORT gmk_file *gmk_lookup_file (const char *name);
+
+/* Return the file NAME, entering it in the database as a target if it is
+   not already there.  This is like writing "NAME:" in a makefile, except
+   that NAME never becomes the default goal.  */
+GMK_EXPORT gmk_file *gmk_enter_file (const char *name);
+
+/* Return the name of FILE.  */
+GMK_EXPORT const char *gmk_file_name (const gmk_file *file);
+
+/* Add the file NAME as a prerequisite of FILE, after its existing ones.
+   The FLAGS value may be GMK_PREREQ_DEFAULT or GMK_PREREQ_ORDER_ONLY.
+   NAME is not expanded or split into words.  Prerequisites may only be
+   added while makefiles are being read.  */
+GMK_EXPORT void gmk_add_prereq (gmk_file *file, const char *name,
+                                unsigned int flags);
+
+#define GMK_PREREQ_DEFAULT      0x00
+#define GMK_PREREQ_ORDER_ONLY   0x01
+
+/* Set the recipe of FILE to RECIPE, replacing any recipe it has.  RECIPE
+   holds the recipe lines without their leading recipe prefix, separated
+   by newlines; it is expanded when the recipe is run, as usual.
+   If FLOC is not NULL it is reported as the location of the recipe.  */
+GMK_EXPORT void gmk_set_commands (gmk_file *file, const char *recipe,
+                                  const gmk_floc *floc);
+
+/* Call FUNC for each prerequisite of FILE, in order, with its flags and
+   ARG.  If FUNC returns nonzero stop and return that value, else return
+   0.  Prerequisites that still need secondary expansion are skipped.  */
+GMK_EXPORT int gmk_foreach_prereq (gmk_file *file, gmk_prereq_func func,
+                                   void *arg);
+
+/* Define the variable NAME with the value VALUE, without expanding it.
+   If FILE is not NULL the variable is specific to that target, otherwise
+   it is global.  The FLAGS value may be GMK_VAR_DEFAULT (a simply
+   expanded variable) or GMK_VAR_RECURSIVE.  */
+GMK_EXPORT void gmk_define_variable (const char *name, const char *value,
+                                     gmk_file *file, unsigned int flags);
+
+#define GMK_VAR_DEFAULT     0x00
+#define GMK_VAR_RECURSIVE   0x01
+
+/* Register FUNC to be asked for the timestamps of files matching PATTERN,
+   which may contain a '%', or of all files if PATTERN is NULL.  It is
+   asked at most once about each file, before make looks at the file
+   itself, and as far as possible about many files in one call: COUNT
+   entries of FILES, each with STATUS GMK_MTIME_DEFAULT.  It may set the
+   STATUS of each entry to:
+
+     GMK_MTIME_DEFAULT:  no answer; make asks later hooks, then the system.
+     GMK_MTIME_SET:      the file's timestamp is SEC and NSEC.
+     GMK_MTIME_MISSING:  the file does not exist.
+     GMK_MTIME_UPTODATE: make gets the timestamp from the system as usual,
+                         but never runs the file's recipe.
+
+   Hooks are asked in the order they were registered.  */
+GMK_EXPORT void gmk_add_mtime_hook (const char *pattern,
+                                    gmk_mtime_func_ptr func);
+
+#define GMK_MTIME_DEFAULT   0
+#define GMK_MTIME_SET       1
+#define GMK_MTIME_MISSING   2
+#define GMK_MTIME_UPTODATE  3
+
+/* Register START to be called before make runs the recipe of a target
+   matching PATTERN, which may contain a '%', or of any target if PATTERN
+   is NULL.  Only the first hook whose pattern matches is called.  The
+   recipe lines in JOB are expanded, but still begin with any '@', '-' or
+   '+' characters.  JOB is only valid until START returns.
+
+   START returns GMK_JOB_RUN to let make run the recipe, or GMK_JOB_DONE
+   if it has brought the target up to date itself (say, by restoring it
+   from a cache) so make runs nothing.  If make runs the recipe and DONE
+   is not NULL, DONE is called afterwards with the target's name and a
+   STATUS of 0 if the recipe succeeded, nonzero if it failed.
+
+   Hooks are not called when recipes are not really run (-n, -q, -t), or
+   for recipes that invoke make recursively.  */
+GMK_EXPORT void gmk_add_job_hook (const char *pattern,
+                                  gmk_job_start_func_ptr start,
+                                  gmk_job_done_func_ptr done);
+
+#define GMK_JOB_RUN     0
+#define GMK_JOB_DONE    1
+
 #endif  /* _GNUMAKE_H_ */
@@ -40,6 +40,25 @@ this program.  If not, see <http://www.gnu.org/licenses/>.  */
 static SCM make_mod = SCM_EOL;
 static SCM obj_to_str = SCM_EOL;
 
+/* Guile procedures registered as make functions with gmk-add-function.  */
+struct guile_function
+  {
+    struct guile_function *next;
+    const char *name;
+    SCM proc;
+  };
+
+static struct guile_function *guile_functions = 0;
+
+/* The arguments of a call to one of them.  */
+struct guile_call
+  {
+    SCM proc;
+    unsigned int argc;
+    char **argv;
+    gmk_output *out;
+  };
+
 /* Convert an SCM object into a string.  */
 static char *
 cvt_scm_to_str (SCM obj)
@@ -77,6 +96,139 @@ guile_eval_wrapper (SCM obj)
   return SCM_BOOL_F;
 }
 
+/* Convert a make word list into a Guile list of strings.  */
+static SCM
+cvt_words_to_scm (const char *words)
+{
+  SCM list = SCM_EOL;
+  const char *p = words;
+  const char *w;
+  size_t len;
+
+  while ((w = find_next_token (&p, &len)) != 0)
+    list = scm_cons (scm_from_locale_stringn (w, len), list);
+
+  return scm_reverse_x (list, SCM_EOL);
+}
+
+/* Append the words of an SCM object to the result of a function, without
+   building a string of the whole object first.  */
+static void
+output_scm (gmk_output *out, SCM obj, int *first)
+{
+  char *str;
+  size_t len;
+
+  while (scm_is_pair (obj))
+    {
+      output_scm (out, SCM_CAR (obj), first);
+      obj = SCM_CDR (obj);
+    }
+
+  if (scm_is_null (obj))
+    return;
+
+  if (scm_is_string (obj))
+    str = scm_to_locale_stringn (obj, &len);
+  else
+    {
+      str = cvt_scm_to_str (obj);
+      len = strlen (str);
+    }
+
+  if (len > 0)
+    {
+      if (! *first)
+        gmk_output_add (out, " ", 1);
+      gmk_output_add (out, str, len);
+      *first = 0;
+    }
+
+  free (str);
+}
+
+static void *
+internal_guile_call (void *arg)
+{
+  struct guile_call *call = arg;
+  SCM args = SCM_EOL;
+  unsigned int i;
+  int first = 1;
+
+  for (i = call->argc; i > 0; --i)
+    args = scm_cons (cvt_words_to_scm (call->argv[i - 1]), args);
+
+  output_scm (call->out, scm_apply_0 (call->proc, args), &first);
+
+  return NULL;
+}
+
+/* The make function for each procedure registered with gmk-add-function.
+   Each argument is passed to the procedure as a list of its words.  */
+static void
+guile_call_function (const char *name, unsigned int argc, char **argv,
+                     const size_t *lens UNUSED, gmk_output *out)
+{
+  struct guile_function *gf;
+  struct guile_call call;
+
+  for (gf = guile_functions; gf != 0; gf = gf->next)
+    if (streq (gf->name, name))
+      break;
+
+  if (gf == 0)
+    return;
+
+  call.proc = gf->proc;
+  call.argc = argc;
+  call.argv = argv;
+  call.out = out;
+
+  scm_with_guile (internal_guile_call, &call);
+}
+
+/* Register a Guile procedure as a GNU make function.  */
+static SCM
+guile_add_function_wrapper (SCM name, SCM proc, SCM min, SCM max)
+{
+  char *str;
+  const char *nm;
+  unsigned int min_args = SCM_UNBNDP (min) ? 0 : scm_to_uint (min);
+  unsigned int max_args = SCM_UNBNDP (max) ? 0 : scm_to_uint (max);
+  struct guile_function *gf;
+
+  SCM_ASSERT (scm_is_true (scm_procedure_p (proc)), proc, SCM_ARG2,
+              "gmk-add-function");
+
+  str = cvt_scm_to_str (name);
+  nm = strcache_add (str);
+  free (str);
+
+  DB (DB_BASIC, (_("guile: Adding function '%s'\n"), nm));
+
+  for (gf = guile_functions; gf != 0; gf = gf->next)
+    if (gf->name == nm)
+      break;
+
+  if (gf == 0)
+    {
+      gf = xmalloc (sizeof (struct guile_function));
+      gf->name = nm;
+      gf->next = guile_functions;
+      guile_functions = gf;
+    }
+  else
+    scm_gc_unprotect_object (gf->proc);
+
+  /* Keep the procedure from being collected while make refers to it.  */
+  gf->proc = scm_gc_protect_object (proc);
+
+  gmk_add_output_function (nm, guile_call_function, min_args, max_args,
+                           GMK_FUNC_DEFAULT);
+
+  return SCM_BOOL_F;
+}
+
 /* Invoked by scm_c_define_module(), in the context of the GNU make module.  */
 static void
 guile_define_module (void *data UNUSED)
@@ -90,6 +242,10 @@ guile_define_module (void *data UNUSED)
   /* Register a subr for GNU make's eval capability.  */
   scm_c_define_gsubr ("gmk-eval", 1, 0, 0, (GSUBR_TYPE) guile_eval_wrapper);
 
+  /* Register a subr to make Guile procedures into GNU make functions.  */
+  scm_c_define_gsubr ("gmk-add-function", 2, 2, 0,
+                      (GSUBR_TYPE) guile_add_function_wrapper);
+
   /* Define the rest of the module.  */
   scm_c_eval_string (GUILE_module_defn);
 }
@@ -37,6 +37,8 @@ try_implicit_rule (struct file *file, unsigned int depth)
 {
   DBF (DB_IMPLICIT, _("Looking for an implicit rule for '%s'.\n"));
 
+  note_implicit_search (file, 0);
+
   /* The order of these searches was previously reversed.  My logic now is
      that since the non-archive search uses more information in the target
      (the archive search omits the archive name), it is more specific and
@@ -154,6 +156,7 @@ struct patdeps
     unsigned int ignore_mtime : 1;
     unsigned int ignore_automatic_vars : 1;
     unsigned int is_explicit : 1;
+    unsigned int wait_here : 1;
   };
 
 /* This structure stores information about pattern rules that we need
@@ -185,6 +188,25 @@ stemlen_compare (const void *v1, const void *v2)
   return r != 0 ? r : (int) (r1->order - r2->order);
 }
 
+/* Return the file called NAME, entering it if it is not in the data base.
+   Files entered here are noted so that --watch can forget them again.  */
+
+static struct file *
+enter_search_file (const char *name)
+{
+  struct file *f = lookup_file (name);
+
+  if (f == 0 || f->search_undone)
+    {
+      if (f == 0)
+        f = enter_file (name);
+      note_implicit_search (f, 1);
+      f->search_undone = 0;
+    }
+
+  return f;
+}
+
 /* Search the pattern rules for a rule with an existing dependency to make
    FILE.  If a rule is found, the appropriate commands and deps are put in FILE
    and 1 is returned.  If not, 0 is returned.
@@ -259,6 +281,8 @@ pattern_search (struct file *file, int archive,
 
   PATH_VAR (stem_str); /* @@ Need to get rid of stem, stemlen, etc. */
 
+  STATS_COUNT (pattern_searches);
+
 #ifndef NO_ARCHIVES
   if (archive || ar_name (filename))
     lastslash = 0;
@@ -459,6 +483,8 @@ pattern_search (struct file *file, int archive,
           if (intermed_ok && rule->terminal)
             continue;
 
+          STATS_COUNT (pattern_rules);
+
           /* From the lengths of the filename and the matching pattern parts,
              find the stem: the part of the filename that matches the %.  */
           matches = tryrules[ri].matches;
@@ -571,6 +597,8 @@ pattern_search (struct file *file, int archive,
                       d->ignore_automatic_vars = dep->ignore_automatic_vars;
                       d->is_explicit = is_explicit;
                     }
+                  if (dl != 0)
+                    dl->wait_here = dep->wait_here;
 
                   /* We've used up this dep, so next time get a new one.  */
                   nptr = 0;
@@ -693,6 +721,8 @@ pattern_search (struct file *file, int archive,
                         }
                     }
                   while (*p != '\0');
+
+                  dl = strip_wait_prereqs (dl);
                 }
 
               /* If there are more than max_pattern_deps prerequisites (due to
@@ -713,6 +743,7 @@ pattern_search (struct file *file, int archive,
               for (d = dl; d != 0; d = d->next)
                 {
                   struct dep *expl_d;
+                  struct file *expl_f;
                   int is_rule = d->name == dep_name (dep);
 
                   if (file_impossible_p (d->name))
@@ -735,6 +766,7 @@ pattern_search (struct file *file, int archive,
                   pat->ignore_mtime = d->ignore_mtime;
                   pat->ignore_automatic_vars = d->ignore_automatic_vars;
                   pat->is_explicit = d->is_explicit;
+                  pat->wait_here = d->wait_here;
 
                   DBS (DB_IMPLICIT,
                        (is_rule
@@ -762,7 +794,8 @@ pattern_search (struct file *file, int archive,
                      FILENAME's directory), so it might actually exist.  */
 
                   /* @@ dep->changed check is disabled. */
-                  if (lookup_file (d->name) != 0
+                  expl_f = lookup_file (d->name);
+                  if ((expl_f != 0 && !expl_f->search_undone)
                       /*|| ((!dep->changed || check_lastslash) && */
                       || file_exists_p (d->name))
                     {
@@ -896,10 +929,13 @@ pattern_search (struct file *file, int archive,
              to be a prerequisite of some (other) target. Mark it as
              secondary.  We don't want it to be precious as that disables
              DELETE_ON_ERROR etc.  */
-          if (f != 0)
-            f->secondary = 1;
+          if (f != 0 && !f->search_undone)
+            {
+              note_implicit_search (f, 0);
+              f->secondary = 1;
+            }
           else
-            f = enter_file (imf->name);
+            f = enter_search_file (imf->name);
 
           f->deps = imf->deps;
           f->cmds = imf->cmds;
@@ -916,12 +952,18 @@ pattern_search (struct file *file, int archive,
           imf = lookup_file (pat->pattern);
           if (imf != 0 && imf->precious)
             f->precious = 1;
+          if (imf != 0 && imf->cacheable)
+            f->cacheable = 1;
 
           for (dep = f->deps; dep != 0; dep = dep->next)
             {
-              dep->file = enter_file (dep->name);
+              dep->file = enter_search_file (dep->name);
               dep->name = 0;
-              dep->file->tried_implicit |= dep->changed;
+              if (dep->changed)
+                {
+                  note_implicit_search (dep->file, 0);
+                  dep->file->tried_implicit = 1;
+                }
             }
         }
 
@@ -929,15 +971,12 @@ pattern_search (struct file *file, int archive,
       dep->ignore_mtime = pat->ignore_mtime;
       dep->is_explicit = pat->is_explicit;
       dep->ignore_automatic_vars = pat->ignore_automatic_vars;
+      dep->wait_here = pat->wait_here;
       s = strcache_add (pat->name);
       if (recursions)
         dep->name = s;
       else
-        {
-          dep->file = lookup_file (s);
-          if (dep->file == 0)
-            dep->file = enter_file (s);
-        }
+        dep->file = enter_search_file (s);
 
       if (pat->file == 0 && tryrules[foundrule].rule->terminal)
         {
@@ -949,7 +988,10 @@ pattern_search (struct file *file, int archive,
           if (dep->file == 0)
             dep->changed = 1;
           else
-            dep->file->tried_implicit = 1;
+            {
+              note_implicit_search (dep->file, 0);
+              dep->file->tried_implicit = 1;
+            }
         }
 
       dep->next = file->deps;
@@ -977,11 +1019,13 @@ pattern_search (struct file *file, int archive,
   file->cmds = rule->cmds;
   file->is_target = 1;
 
-  /* Set precious and notintermediate flags. */
+  /* Set precious, cacheable and notintermediate flags. */
   {
     struct file *f = lookup_file (rule->targets[tryrules[foundrule].matches]);
     if (f && f->precious)
       file->precious = 1;
+    if (f && f->cacheable)
+      file->cacheable = 1;
     if (f && f->notintermediate)
       file->notintermediate = 1;
   }
@@ -1007,8 +1051,9 @@ pattern_search (struct file *file, int archive,
           memcpy (p, rule->suffixes[ri],
                   rule->lens[ri] - (rule->suffixes[ri] - rule->targets[ri])+1);
           new->name = strcache_add (nm);
-          new->file = enter_file (new->name);
+          new->file = enter_search_file (new->name);
           new->next = file->also_make;
+          note_implicit_search (new->file, 0);
 
           /* Set precious flag. */
           f = lookup_file (rule->targets[ri]);
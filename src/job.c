@@ -21,6 +21,7 @@ this program.  If not, see <http://www.gnu.org/licenses/>.  */
 
 #include "job.h"
 #include "debug.h"
+#include "events.h"
 #include "filedef.h"
 #include "commands.h"
 #include "variable.h"
@@ -223,6 +224,9 @@ static void start_job_command (struct child *child);
 static int load_too_high (void);
 static int job_next_command (struct child *);
 static int start_waiting_job (struct child *);
+static unsigned int free_job_slot (void);
+static void start_new_job (struct file *file, unsigned int first,
+                           char **lines, int trace);
 
 /* Chain of all live (or recently deceased) children.  */
 
@@ -240,6 +244,33 @@ static int good_stdin_used = 0;
 
 static struct child *waiting_jobs = 0;
 
+/* Job hooks registered by loaded objects, in order.  */
+
+struct job_hook
+  {
+    struct job_hook *next;
+    const char *pattern;        /* Targets it applies to, or NULL for all.  */
+    const char *percent;        /* The '%' in PATTERN, if any.  */
+    gmk_job_start_func_ptr start;
+    gmk_job_done_func_ptr done;
+  };
+
+static struct job_hook *job_hooks = 0;
+
+/* Resource pools.  At most SIZE recipes of the targets whose '.POOL'
+   variable names a pool may run at once; the size of pool NAME is the
+   value of the variable '.POOL.NAME'.  */
+
+struct pool
+  {
+    struct pool *next;
+    const char *name;           /* Name of the pool, in the strcache.  */
+    unsigned int size;          /* Most recipes which may run at once.  */
+    unsigned int running;       /* Recipes of its members running now.  */
+  };
+
+static struct pool *pools = 0;
+
 /* Non-zero if we use a *real* shell (always so on Unix).  */
 
 int unixy_shell = 1;
@@ -743,7 +774,9 @@ reap_children (int block, int err)
                 status = (c->cstatus >> 3 & 255) << 8;
 #else
 #ifdef WAIT_NOHANG
-              if (!block)
+              /* With remote children around, don't sleep on the local ones
+                 alone; we wait for both below.  */
+              if (!block || any_remote)
                 pid = WAIT_NOHANG (&status);
               else
 #endif
@@ -773,6 +806,19 @@ reap_children (int block, int err)
               if (!block || !any_remote)
                 break;
 
+#ifdef WAIT_NOHANG
+              /* If the remote backend can tell us when to look again,
+                 sleep until a local or a remote child finishes.  */
+              {
+                int fd;
+                if (remote_status_fds (&fd, 1) > 0)
+                  {
+                    os_wait_for_children ();
+                    continue;
+                  }
+              }
+#endif
+
               /* Now try a blocking wait for a remote child.  */
               pid = remote_status (&exit_code, &exit_sig, &coredump, 1);
               if (pid < 0)
@@ -904,6 +950,19 @@ reap_children (int block, int err)
       if (job_counter)
         --job_counter;
 
+      if (EVENTS_ENABLED)
+        {
+          event_begin ("job-finish");
+          event_str ("target", c->file->name);
+          event_int ("child", (long) c->pid);
+          event_int ("slot", c->slot);
+          event_int ("line", c->command_line);
+          event_num ("duration", clock_seconds () - c->start_time);
+          event_int ("exit", exit_code);
+          event_int ("signal", exit_sig);
+          event_end ();
+        }
+
     process_child:
 
 #if defined(USE_POSIX_SPAWN)
@@ -1010,8 +1069,9 @@ reap_children (int block, int err)
                 {
 #ifndef NO_OUTPUT_SYNC
                   /* If we're sync'ing per line, write the previous line's
-                     output before starting the next one.  */
-                  if (output_sync == OUTPUT_SYNC_LINE)
+                     output before starting the next one.  Output that
+                     is going into the cache is kept until the end.  */
+                  if (output_sync == OUTPUT_SYNC_LINE && c->cache_entry == 0)
                     output_dump (&c->output);
 #endif
                   /* Check again whether to start remotely.
@@ -1044,11 +1104,20 @@ reap_children (int block, int err)
 
       /* When we get here, all the commands for c->file are finished.  */
 
+      /* Save the results of a cacheable recipe that succeeded.  */
+      if (c->cache_entry != 0 && c->file->update_status == us_success
+          && !handling_fatal_signal)
+        cache_store (c);
+
 #ifndef NO_OUTPUT_SYNC
       /* Synchronize any remaining parallel output.  */
       output_dump (&c->output);
 #endif
 
+      /* Tell the job hook that let us run the job how it went.  */
+      if (c->hook != 0)
+        c->hook->done (c->file->name, c->file->update_status != us_success);
+
       /* At this point c->file->update_status is success or failed.  But
          c->file->command_state is still cs_running if all the commands
          ran; notice_finished_file looks for cs_running to tell it that
@@ -1124,6 +1193,9 @@ free_child (struct child *child)
 
   --jobserver_tokens;
 
+  if (child->pool != 0)
+    --child->pool->running;
+
   if (handling_fatal_signal) /* Don't bother free'ing if about to die.  */
     return;
 
@@ -1136,14 +1208,10 @@ free_child (struct child *child)
     }
 
   if (child->environment != 0)
-    {
-      char **ep = child->environment;
-      while (*ep != 0)
-        free (*ep++);
-      free (child->environment);
-    }
+    free_target_environment (child->environment);
 
   free (child->cmd_name);
+  free (child->cache_entry);
   free (child);
 }
 
@@ -1330,6 +1398,11 @@ start_job_command (struct child *child)
      output_sync separately below in case it changes due to error.  */
   child->output.syncout = output_sync && (output_sync == OUTPUT_SYNC_RECURSE
                                           || !(flags & COMMANDS_RECURSE));
+#ifndef NO_OUTPUT_SYNC
+  /* Capture the output of a recipe whose results will be cached.  */
+  if (child->cache_entry != 0)
+    child->output.syncout = 1;
+#endif
 
   OUTPUT_SET (&child->output);
 
@@ -1415,14 +1488,26 @@ start_job_command (struct child *child)
 #if !defined(__MSDOS__) && !defined(_AMIGA) && !defined(WINDOWS32)
 
 #ifndef VMS
-  /* start_waiting_job has set CHILD->remote if we can start a remote job.  */
-  if (child->remote)
+  /* start_waiting_job has set CHILD->remote if we can start a remote job.
+     Recursive make invocations always run locally.  */
+  if (child->remote && !(flags & COMMANDS_RECURSE))
     {
       int is_remote, used_stdin;
+      int fdout = FD_STDOUT, fderr = FD_STDERR;
       pid_t id;
+
+      /* Divert the job's output if we want to capture it.  */
+      if (child->output.syncout)
+        {
+          if (child->output.out >= 0)
+            fdout = child->output.out;
+          if (child->output.err >= 0)
+            fderr = child->output.err;
+        }
+
       if (start_remote_job (argv, child->environment,
                             child->good_stdin ? 0 : get_bad_stdin (),
-                            &is_remote, &id, &used_stdin))
+                            fdout, fderr, &is_remote, &id, &used_stdin))
         /* Don't give up; remote execution may fail for various reasons.  If
            so, simply run the job locally.  */
         goto run_local;
@@ -1443,6 +1528,7 @@ start_job_command (struct child *child)
       /* Fork the child process.  */
 
       char **parent_environ;
+      double start;
 
     run_local:
       block_sigs ();
@@ -1458,8 +1544,14 @@ start_job_command (struct child *child)
 
       jobserver_pre_child (flags & COMMANDS_RECURSE);
 
+      start = clock_seconds ();
       child->pid = child_execute_job ((struct childbase *)child,
                                       child->good_stdin, argv);
+      if (child->pid > 0)
+        {
+          STATS_COUNT (spawns);
+          stats_process_started (start);
+        }
 
       environ = parent_environ; /* Restore value child may have clobbered.  */
       jobserver_post_child (flags & COMMANDS_RECURSE);
@@ -1588,6 +1680,18 @@ start_job_command (struct child *child)
   if (child->pid >= 0)
     ++job_counter;
 
+  if (EVENTS_ENABLED && child->pid > 0)
+    {
+      child->start_time = clock_seconds ();
+      event_begin ("job-start");
+      event_str ("target", child->file->name);
+      event_int ("child", (long) child->pid);
+      event_int ("slot", child->slot);
+      event_int ("line", child->command_line);
+      event_bool ("remote", child->remote);
+      event_end ();
+    }
+
   /* Set the state to running.  */
   set_command_state (child->file, cs_running);
 
@@ -1599,6 +1703,106 @@ start_job_command (struct child *child)
 #undef FREE_ARGV
 }
 
+/* Return the lowest job slot number not in use by a running child.  The
+   number only identifies the slot in events; nothing else depends on it.  */
+
+static unsigned int
+free_job_slot (void)
+{
+  unsigned int slot = 0;
+  struct child *c;
+
+ again:
+  for (c = children; c != 0; c = c->next)
+    if (c->jobslot && c->slot == slot)
+      {
+        ++slot;
+        goto again;
+      }
+
+  return slot;
+}
+
+/* Return the resource pool FILE's recipe belongs to, or NULL.  It is
+   looked up the first time and remembered in FILE.  */
+
+static struct pool *
+file_pool (struct file *file)
+{
+  struct variable_set_list *save = current_variable_set_list;
+  struct variable *v, *sv;
+  struct pool *p;
+  const char *name;
+  char *value, *var, *end;
+  const char *np;
+  size_t len;
+  long size;
+
+  if (file->pool_known)
+    return file->pool;
+  file->pool_known = 1;
+
+  initialize_file_variables (file, 0);
+  current_variable_set_list = file->variables;
+  v = lookup_variable (STRING_SIZE_TUPLE (".POOL"));
+  current_variable_set_list = save;
+  if (v == 0)
+    return 0;
+
+  value = allocated_variable_expand_for_file ("$(.POOL)", file);
+  np = value;
+  name = find_next_token (&np, &len);
+  if (name == 0)
+    {
+      free (value);
+      return 0;
+    }
+  name = strcache_add_len (name, len);
+  free (value);
+
+  for (p = pools; p != 0; p = p->next)
+    if (p->name == name)
+      return file->pool = p;
+
+  var = alloca (CSTRLEN ("$(.POOL.)") + len + 1);
+  sprintf (var, "$(.POOL.%s)", name);
+  current_variable_set_list = file->variables;
+  sv = lookup_variable (var + 2, CSTRLEN (".POOL.") + len);
+  current_variable_set_list = save;
+  value = allocated_variable_expand_for_file (var, file);
+  if (sv == 0 || *next_token (value) == '\0')
+    OS (fatal, &v->fileinfo, _("undefined pool '%s'"), name);
+  size = strtol (value, &end, 10);
+  if (end == value || *next_token (end) != '\0' || size <= 0)
+    OSS (fatal, &sv->fileinfo, _("invalid size '%s' for pool '%s'"),
+         value, name);
+  free (value);
+
+  p = xcalloc (sizeof (struct pool));
+  p->name = name;
+  p->size = (unsigned int) size;
+  p->next = pools;
+  pools = p;
+
+  return file->pool = p;
+}
+
+/* Return nonzero if FILE's recipe may be started now, zero if its
+   resource pool already has as many recipes running as it allows.
+   Pools only matter when jobs may run in parallel.  */
+
+int
+pool_available (struct file *file)
+{
+  struct pool *p;
+
+  if (job_slots == 1 || not_parallel || file->cmds == 0)
+    return 1;
+
+  p = file_pool (file);
+  return p == 0 || p->running < p->size;
+}
+
 /* Try to start a child running.
    Returns nonzero if the child was started (and maybe finished), or zero if
    the load was too high and the child was put on the 'waiting_jobs' chain.  */
@@ -1631,6 +1835,9 @@ start_waiting_job (struct child *c)
       return 0;
     }
 
+  if (EVENTS_ENABLED)
+    c->slot = free_job_slot ();
+
   /* Start the first command; reap_children will run later command lines.  */
   start_job_command (c);
 
@@ -1670,14 +1877,400 @@ start_waiting_job (struct child *c)
   return 1;
 }
 
+void
+define_job_hook (const char *pattern, gmk_job_start_func_ptr start,
+                 gmk_job_done_func_ptr done)
+{
+  struct job_hook *hook = xmalloc (sizeof (struct job_hook));
+  struct job_hook **hp;
+
+  hook->next = 0;
+  hook->pattern = pattern && *pattern ? strcache_add (pattern) : 0;
+  hook->percent = hook->pattern ? strchr (hook->pattern, '%') : 0;
+  hook->start = start;
+  hook->done = done;
+
+  for (hp = &job_hooks; *hp != 0; hp = &(*hp)->next)
+    ;
+  *hp = hook;
+}
+
+/* Offer the job C, whose command lines are expanded, to the first job hook
+   that matches its target.  Return nonzero if the hook did the job.  */
+
+static int
+start_job_hook (struct child *c)
+{
+  struct job_hook *hook;
+  gmk_job job;
+
+  for (hook = job_hooks; hook != 0; hook = hook->next)
+    if (hook->pattern == 0
+        || pattern_matches (hook->pattern, hook->percent, c->file->name))
+      break;
+
+  if (hook == 0)
+    return 0;
+
+  if (c->environment == 0)
+    c->environment = target_environment (c->file);
+
+  job.target = c->file->name;
+  job.ncommands = c->file->cmds->ncommand_lines;
+  job.commands = (const char **) c->command_lines;
+  job.envp = c->environment;
+
+  if (hook->start (&job) == GMK_JOB_DONE)
+    return 1;
+
+  if (hook->done)
+    c->hook = hook;
+  return 0;
+}
+
+/* Expand line I of the recipe for FILE and return it in malloc'd memory.  */
+
+static char *
+expand_command_line (struct file *file, unsigned int i)
+{
+  struct commands *cmds = file->cmds;
+  char *in, *out, *ref;
+
+  /* Collapse backslash-newline combinations that are inside variable
+     or function references.  These are left alone by the parser so
+     that they will appear in the echoing of commands (where they look
+     nice); and collapsed by construct_command_argv when it tokenizes.
+     But letting them survive inside function invocations loses because
+     we don't want the functions to see them as part of the text.  */
+
+  /* IN points to where in the line we are scanning.
+     OUT points to where in the line we are writing.
+     When we collapse a backslash-newline combination,
+     IN gets ahead of OUT.  */
+
+  in = out = cmds->command_lines[i];
+  while ((ref = strchr (in, '$')) != 0)
+    {
+      ++ref;                /* Move past the $.  */
+
+      if (out != in)
+        /* Copy the text between the end of the last chunk
+           we processed (where IN points) and the new chunk
+           we are about to process (where REF points).  */
+        memmove (out, in, ref - in);
+
+      /* Move both pointers past the boring stuff.  */
+      out += ref - in;
+      in = ref;
+
+      if (*ref == '(' || *ref == '{')
+        {
+          char openparen = *ref;
+          char closeparen = openparen == '(' ? ')' : '}';
+          char *outref;
+          int count;
+          char *p;
+
+          *out++ = *in++;   /* Copy OPENPAREN.  */
+          outref = out;
+          /* IN now points past the opening paren or brace.
+             Count parens or braces until it is matched.  */
+          count = 0;
+          while (*in != '\0')
+            {
+              if (*in == closeparen && --count < 0)
+                break;
+              else if (*in == '\\' && in[1] == '\n')
+                {
+                  /* We have found a backslash-newline inside a
+                     variable or function reference.  Eat it and
+                     any following whitespace.  */
+
+                  int quoted = 0;
+                  for (p = in - 1; p > ref && *p == '\\'; --p)
+                    quoted = !quoted;
+
+                  if (quoted)
+                    /* There were two or more backslashes, so this is
+                       not really a continuation line.  We don't collapse
+                       the quoting backslashes here as is done in
+                       collapse_continuations, because the line will
+                       be collapsed again after expansion.  */
+                    *out++ = *in++;
+                  else
+                    {
+                      /* Skip the backslash, newline, and whitespace.  */
+                      in += 2;
+                      NEXT_TOKEN (in);
+
+                      /* Discard any preceding whitespace that has
+                         already been written to the output.  */
+                      while (out > outref && ISBLANK (out[-1]))
+                        --out;
+
+                      /* Replace it all with a single space.  */
+                      *out++ = ' ';
+                    }
+                }
+              else
+                {
+                  if (*in == openparen)
+                    ++count;
+
+                  *out++ = *in++;
+                }
+            }
+        }
+    }
+
+  /* There are no more references in this line to worry about.
+     Copy the remaining uninteresting text to the output.  */
+  if (out != in)
+    memmove (out, in, strlen (in) + 1);
+
+  /* Finally, expand the line.  */
+  cmds->fileinfo.offset = i;
+  return allocated_variable_expand_for_file (cmds->command_lines[i], file);
+}
+
+/* Say why FILE is being updated, for --debug=why.
+   Use message here so that changes to working directories are logged.  */
+
+static void
+trace_update (struct file *file)
+{
+  struct commands *cmds = file->cmds;
+  char *newer;
+  const char *nm;
+
+  if (!ISDB (DB_WHY))
+    return;
+
+  newer = allocated_variable_expand_for_file ("$?", file);
+
+  if (! cmds->fileinfo.filenm)
+    nm = _("<builtin>");
+  else
+    {
+      char *n = alloca (strlen (cmds->fileinfo.filenm) + 1 + 11 + 1);
+      sprintf (n, "%s:%lu", cmds->fileinfo.filenm, cmds->fileinfo.lineno);
+      nm = n;
+    }
+
+  OSSS (message, 0,
+        _("%s: update target '%s' due to: %s"), nm, file->name,
+          newer[0] == '\0' ? _("target does not exist") : newer);
+
+  free (newer);
+}
+
+/* Return nonzero if some command in LINE, the expansion of a recipe line,
+   starts with '+'.  Commands are separated by newlines; one inside a quoted
+   string is taken as a separator too, which can only give a false alarm.  */
+
+static int
+recursive_text (const char *line)
+{
+  const char *p = line;
+
+  while (p != 0)
+    {
+      while (*p == '@' || *p == '-' || ISBLANK (*p))
+        ++p;
+      if (*p == '+')
+        return 1;
+      p = strchr (p, '\n');
+      if (p != 0)
+        ++p;
+    }
+
+  return 0;
+}
+
+/* Take the next command from *LINEP, which is line I of the recipe for
+   FILE after expansion, as start_job_command would: skip its prefix
+   characters, leave its text in *CMDP and point *LINEP past it.  Return
+   its argument list, or null if it is empty.  */
+
+static char **
+next_dry_command (struct file *file, unsigned int i, char **linep,
+                  char **cmdp)
+{
+  char prefix = file->cmds->recipe_prefix;
+  char *p = *linep;
+  char *batch_file = 0;
+  char *end = 0;
+  char **argv;
+  char *p1, *p2;
+
+  while (*p == '@' || *p == '-' || ISBLANK (*p))
+    ++p;
+
+  /* Remove a recipe prefix after a backslash-newline.  */
+  p1 = p2 = p;
+  while (*p1 != '\0')
+    {
+      *(p2++) = *p1;
+      if (p1[0] == '\n' && p1[1] == prefix)
+        ++p1;
+      ++p1;
+    }
+  *p2 = *p1;
+
+  argv = construct_command_argv (p, &end, file, file->cmds->lines_flags[i],
+                                 &batch_file);
+  if (end != 0)
+    *end++ = '\0';
+
+  if (batch_file != 0)
+    {
+      remove (batch_file);
+      free (batch_file);
+    }
+
+  *cmdp = p;
+  *linep = end;
+  return argv;
+}
+
+/* Under -q, find out whether the recipe for FILE, which has no recursive
+   lines, would run anything, without starting a job for it.  Lines are only
+   expanded, one at a time, until one of them has a command.  */
+
+void
+question_commands (struct file *file)
+{
+  struct commands *cmds = file->cmds;
+  enum update_status status = us_success;
+  int vars_set = 0;
+  unsigned int i;
+
+  trace_update (file);
+
+  for (i = 0; i < cmds->ncommand_lines && status == us_success; ++i)
+    {
+      char *line;
+      char *p;
+
+      if (strchr (cmds->command_lines[i], '$') == 0)
+        line = xstrdup (cmds->command_lines[i]);
+      else
+        {
+          if (!vars_set)
+            {
+              initialize_file_variables (file, 0);
+              set_file_variables (file);
+              vars_set = 1;
+            }
+          line = expand_command_line (file, i);
+
+          /* A '+' from the expansion makes the line recursive.  */
+          if (recursive_text (line))
+            {
+              char **lines = xcalloc (cmds->ncommand_lines * sizeof (char *));
+
+              lines[i] = line;
+              cmds->fileinfo.offset = 0;
+              start_new_job (file, i, lines, 0);
+              return;
+            }
+        }
+
+      p = line;
+      while (p != 0 && *p != '\0')
+        {
+          char *cmd;
+          char **argv = next_dry_command (file, i, &p, &cmd);
+
+          if (argv != 0)
+            {
+              free (argv[0]);
+              free (argv);
+              status = us_question;
+              break;
+            }
+        }
+
+      free (line);
+    }
+
+  cmds->fileinfo.offset = 0;
+  set_command_state (file, cs_running);
+  file->update_status = status;
+  notice_finished_file (file);
+}
+
+/* Under -n, print the recipe for FILE, which has no recursive lines,
+   without starting a job for it.  All the lines are expanded first, as they
+   are for a job.  If one turns out to be recursive after all, a job is
+   started to deal with the recipe.  */
+
+void
+just_print_commands (struct file *file)
+{
+  struct commands *cmds = file->cmds;
+  char **lines;
+  unsigned int i;
+
+  lines = xmalloc (cmds->ncommand_lines * sizeof (char *));
+  for (i = 0; i < cmds->ncommand_lines; ++i)
+    lines[i] = expand_command_line (file, i);
+  cmds->fileinfo.offset = 0;
+
+  for (i = 0; i < cmds->ncommand_lines; ++i)
+    if (recursive_text (lines[i]))
+      {
+        start_new_job (file, 0, lines, 1);
+        return;
+      }
+
+  trace_update (file);
+
+  for (i = 0; i < cmds->ncommand_lines; ++i)
+    {
+      char *p = lines[i];
+
+      while (p != 0 && *p != '\0')
+        {
+          char *cmd;
+          char **argv = next_dry_command (file, i, &p, &cmd);
+
+          if (argv != 0)
+            {
+              OS (message, 0, "%s", cmd);
+              ++commands_started;
+              free (argv[0]);
+              free (argv);
+            }
+        }
+
+      free (lines[i]);
+    }
+  free (lines);
+
+  set_command_state (file, cs_running);
+  file->update_status = us_success;
+  notice_finished_file (file);
+}
+
 /* Create a 'struct child' for FILE and start its commands running.  */
 
 void
 new_job (struct file *file)
+{
+  start_new_job (file, 0, 0, 1);
+}
+
+/* Start a job for FILE's recipe from line FIRST on; the lines before it
+   have been dealt with already.  If LINES is not null, it holds the
+   expansions of the lines that have been expanded, and null for the others.
+   If TRACE is nonzero, say why FILE is being updated.  */
+
+static void
+start_new_job (struct file *file, unsigned int first, char **lines, int trace)
 {
   struct commands *cmds = file->cmds;
   struct child *c;
-  char **lines;
   unsigned int i;
 
   /* Let any previously decided-upon jobs that are waiting
@@ -1707,108 +2300,16 @@ new_job (struct file *file)
   OUTPUT_SET (&c->output);
 
   /* Expand the command lines and store the results in LINES.  */
-  lines = xmalloc (cmds->ncommand_lines * sizeof (char *));
+  if (lines == 0)
+    lines = xcalloc (cmds->ncommand_lines * sizeof (char *));
   for (i = 0; i < cmds->ncommand_lines; ++i)
-    {
-      /* Collapse backslash-newline combinations that are inside variable
-         or function references.  These are left alone by the parser so
-         that they will appear in the echoing of commands (where they look
-         nice); and collapsed by construct_command_argv when it tokenizes.
-         But letting them survive inside function invocations loses because
-         we don't want the functions to see them as part of the text.  */
-
-      char *in, *out, *ref;
-
-      /* IN points to where in the line we are scanning.
-         OUT points to where in the line we are writing.
-         When we collapse a backslash-newline combination,
-         IN gets ahead of OUT.  */
-
-      in = out = cmds->command_lines[i];
-      while ((ref = strchr (in, '$')) != 0)
-        {
-          ++ref;                /* Move past the $.  */
-
-          if (out != in)
-            /* Copy the text between the end of the last chunk
-               we processed (where IN points) and the new chunk
-               we are about to process (where REF points).  */
-            memmove (out, in, ref - in);
-
-          /* Move both pointers past the boring stuff.  */
-          out += ref - in;
-          in = ref;
-
-          if (*ref == '(' || *ref == '{')
-            {
-              char openparen = *ref;
-              char closeparen = openparen == '(' ? ')' : '}';
-              char *outref;
-              int count;
-              char *p;
-
-              *out++ = *in++;   /* Copy OPENPAREN.  */
-              outref = out;
-              /* IN now points past the opening paren or brace.
-                 Count parens or braces until it is matched.  */
-              count = 0;
-              while (*in != '\0')
-                {
-                  if (*in == closeparen && --count < 0)
-                    break;
-                  else if (*in == '\\' && in[1] == '\n')
-                    {
-                      /* We have found a backslash-newline inside a
-                         variable or function reference.  Eat it and
-                         any following whitespace.  */
-
-                      int quoted = 0;
-                      for (p = in - 1; p > ref && *p == '\\'; --p)
-                        quoted = !quoted;
-
-                      if (quoted)
-                        /* There were two or more backslashes, so this is
-                           not really a continuation line.  We don't collapse
-                           the quoting backslashes here as is done in
-                           collapse_continuations, because the line will
-                           be collapsed again after expansion.  */
-                        *out++ = *in++;
-                      else
-                        {
-                          /* Skip the backslash, newline, and whitespace.  */
-                          in += 2;
-                          NEXT_TOKEN (in);
-
-                          /* Discard any preceding whitespace that has
-                             already been written to the output.  */
-                          while (out > outref && ISBLANK (out[-1]))
-                            --out;
-
-                          /* Replace it all with a single space.  */
-                          *out++ = ' ';
-                        }
-                    }
-                  else
-                    {
-                      if (*in == openparen)
-                        ++count;
-
-                      *out++ = *in++;
-                    }
-                }
-            }
-        }
-
-      /* There are no more references in this line to worry about.
-         Copy the remaining uninteresting text to the output.  */
-      if (out != in)
-        memmove (out, in, strlen (in) + 1);
-
-      /* Finally, expand the line.  */
-      cmds->fileinfo.offset = i;
-      lines[i] = allocated_variable_expand_for_file (cmds->command_lines[i],
-                                                     file);
-    }
+    if (i < first)
+      {
+        free (lines[i]);
+        lines[i] = xstrdup ("");
+      }
+    else if (lines[i] == 0)
+      lines[i] = expand_command_line (file, i);
 
   cmds->fileinfo.offset = 0;
   c->command_lines = lines;
@@ -1867,8 +2368,17 @@ new_job (struct file *file)
         if (!children)
           O (fatal, NILF, "INTERNAL: no children as we go to sleep on read\n");
 
-        /* Get a token.  */
-        got_token = jobserver_acquire (waiting_jobs != NULL);
+        /* Get a token.  Remote children may not be able to interrupt the
+           wait, so time out to look at them if there are any.  */
+        {
+          struct child *r;
+          int any_remote = 0;
+
+          for (r = children; r != 0; r = r->next)
+            any_remote |= r->remote;
+
+          got_token = jobserver_acquire (waiting_jobs != NULL || any_remote);
+        }
 
         /* If we got one, we're done here.  */
         if (got_token == 1)
@@ -1882,27 +2392,44 @@ new_job (struct file *file)
 
   ++jobserver_tokens;
 
-  /* Trace the build.
-     Use message here so that changes to working directories are logged.  */
-  if (ISDB (DB_WHY))
+  /* Trace the build.  */
+  if (trace)
+    trace_update (file);
+
+  /* The cache or a job hook may be able to bring the target up to date
+     without running anything.  Treat the job as having run, so its
+     target's time is checked again.  */
+  if (cmds->ncommand_lines > 0 && !cmds->any_recurse
+      && !just_print_flag && !question_flag && !touch_flag)
     {
-      char *newer = allocated_variable_expand_for_file ("$?", c->file);
-      const char *nm;
+      int updated = 0;
 
-      if (! cmds->fileinfo.filenm)
-        nm = _("<builtin>");
-      else
+      if (file->cacheable && cache_lookup (c))
+        updated = 1;
+      else if (job_hooks != 0 && start_job_hook (c))
         {
-          char *n = alloca (strlen (cmds->fileinfo.filenm) + 1 + 11 + 1);
-          sprintf (n, "%s:%lu", cmds->fileinfo.filenm, cmds->fileinfo.lineno);
-          nm = n;
+          DB (DB_JOBS, (_("Job hook updated '%s'.\n"), file->name));
+          updated = 1;
         }
 
-      OSSS (message, 0,
-            _("%s: update target '%s' due to: %s"), nm, c->file->name,
-              newer[0] == '\0' ? _("target does not exist") : newer);
+      if (updated)
+        {
+          ++commands_started;
+          set_command_state (file, cs_running);
+          file->update_status = us_success;
+          notice_finished_file (file);
+          free_child (c);
+          OUTPUT_UNSET ();
+          return;
+        }
+    }
 
-      free (newer);
+  /* Count the job against its pool until it is freed.  */
+  if (job_slots != 1 && !not_parallel)
+    {
+      c->pool = file_pool (file);
+      if (c->pool != 0)
+        ++c->pool->running;
     }
 
   /* The job is now primed.  Start it running.
@@ -63,6 +63,12 @@ struct child
     unsigned int  recursive:1;  /* Nonzero for recursive command ('+' etc.)  */
     unsigned int  jobslot:1;    /* Nonzero if it's reserved a job slot.  */
     unsigned int  dontcare:1;   /* Saved dontcare flag.  */
+
+    struct job_hook *hook;      /* Job hook to tell when the job is done.  */
+    unsigned int slot;          /* Job slot number, for --events.  */
+    double start_time;          /* When the current command started.  */
+    char *cache_entry;          /* Cache entry to save the results in.  */
+    struct pool *pool;          /* Resource pool it is counted in.  */
   };
 
 extern struct child *children;
@@ -71,8 +77,15 @@ extern struct child *children;
 RETSIGTYPE child_handler (int sig);
 int is_bourne_compatible_shell(const char *path);
 void new_job (struct file *file);
+void question_commands (struct file *file);
+void just_print_commands (struct file *file);
+int pool_available (struct file *file);
 void reap_children (int block, int err);
 void start_waiting_jobs (void);
+void define_job_hook (const char *pattern, gmk_job_start_func_ptr start,
+                      gmk_job_done_func_ptr done);
+int cache_lookup (struct child *c);
+void cache_store (struct child *c);
 
 char **construct_command_argv (char *line, char **restp, struct file *file,
                                int cmd_flags, char** batch_file);
@@ -17,8 +17,10 @@ this program.  If not, see <http://www.gnu.org/licenses/>.  */
 #include "makeint.h"
 
 #include "filedef.h"
-#include "variable.h"
 #include "dep.h"
+#include "job.h"
+#include "commands.h"
+#include "variable.h"
 
 /* Allocate a buffer in our context, so we can free it.  */
 char *
@@ -80,3 +82,161 @@ gmk_add_function (const char *name, gmk_func_ptr func,
 {
   define_new_function (reading_file, name, min, max, flags, func);
 }
+
+/* Register a function that writes its result directly.  */
+void
+gmk_add_output_function (const char *name, gmk_output_func_ptr func,
+                         unsigned int min, unsigned int max,
+                         unsigned int flags)
+{
+  define_new_output_function (reading_file, name, min, max, flags, func);
+}
+
+/* Register a timestamp hook.  */
+void
+gmk_add_mtime_hook (const char *pattern, gmk_mtime_func_ptr func)
+{
+  define_mtime_hook (pattern, func);
+}
+
+/* Register a job hook.  */
+void
+gmk_add_job_hook (const char *pattern, gmk_job_start_func_ptr start,
+                  gmk_job_done_func_ptr done)
+{
+  define_job_hook (pattern, start, done);
+}
+
+/* Append to the result of a function.  */
+void
+gmk_output_add (gmk_output *out, const char *str, size_t len)
+{
+  out->o = variable_buffer_output (out->o, str, len);
+}
+
+/* Look up a file in the database.  */
+gmk_file *
+gmk_lookup_file (const char *name)
+{
+  return lookup_file (name);
+}
+
+/* Enter a file in the database as a target, as a rule would.  */
+gmk_file *
+gmk_enter_file (const char *name)
+{
+  struct file *f = lookup_file (name);
+
+  if (f == 0)
+    f = enter_file (strcache_add (name));
+  else if (f->double_colon)
+    OS (fatal, reading_file,
+        _("target file '%s' has both : and :: entries"), f->name);
+
+  f->is_target = 1;
+  return f;
+}
+
+const char *
+gmk_file_name (const gmk_file *file)
+{
+  return file->name;
+}
+
+/* Add a prerequisite to a file without parsing makefile syntax.  */
+void
+gmk_add_prereq (gmk_file *file, const char *name, unsigned int flags)
+{
+  struct dep *d, **dp;
+
+  /* See record_files().  */
+  if (snapped_deps)
+    O (fatal, reading_file, _("prerequisites cannot be defined in recipes"));
+
+  d = alloc_dep ();
+  d->name = strcache_add (name);
+  d->ignore_mtime = ANY_SET (flags, GMK_PREREQ_ORDER_ONLY);
+  d = enter_prereqs (d, NULL);
+
+  for (dp = &file->deps; *dp != 0; dp = &(*dp)->next)
+    ;
+  *dp = d;
+}
+
+/* Set the recipe for a file.  */
+void
+gmk_set_commands (gmk_file *file, const char *recipe, const gmk_floc *gfloc)
+{
+  struct commands *cmds;
+
+  if (snapped_deps)
+    O (fatal, reading_file, _("recipes cannot be defined in recipes"));
+
+  cmds = xmalloc (sizeof (struct commands));
+  if (gfloc)
+    {
+      cmds->fileinfo.filenm = strcache_add (gfloc->filenm);
+      cmds->fileinfo.lineno = gfloc->lineno;
+    }
+  else if (reading_file)
+    {
+      cmds->fileinfo.filenm = reading_file->filenm;
+      cmds->fileinfo.lineno = reading_file->lineno;
+    }
+  else
+    {
+      cmds->fileinfo.filenm = 0;
+      cmds->fileinfo.lineno = 0;
+    }
+  cmds->fileinfo.offset = 0;
+  cmds->commands = xstrdup (recipe);
+  cmds->command_lines = 0;
+  cmds->recipe_prefix = cmd_prefix;
+
+  file->cmds = cmds;
+}
+
+/* Walk the prerequisites of a file.  */
+int
+gmk_foreach_prereq (gmk_file *file, gmk_prereq_func func, void *arg)
+{
+  struct dep *d;
+
+  for (d = file->deps; d != 0; d = d->next)
+    if (d->file != 0)
+      {
+        int r = func (d->file, (d->ignore_mtime
+                                ? GMK_PREREQ_ORDER_ONLY : GMK_PREREQ_DEFAULT),
+                      arg);
+        if (r)
+          return r;
+      }
+
+  return 0;
+}
+
+/* Define a global or target-specific variable without parsing makefile
+   syntax.  */
+void
+gmk_define_variable (const char *name, const char *value, gmk_file *file,
+                     unsigned int flags)
+{
+  size_t len = strlen (name);
+  int recursive = ANY_SET (flags, GMK_VAR_RECURSIVE);
+
+  if (file == 0)
+    define_variable_global (name, len, value, o_file, recursive,
+                            reading_file);
+  else
+    {
+      struct variable *v;
+
+      if (file->double_colon)
+        file = file->double_colon;
+
+      initialize_file_variables (file, 1);
+      v = define_variable_in_set (name, len, value, o_file, recursive,
+                                  file->variables->set, reading_file);
+      v->per_target = 1;
+    }
+}
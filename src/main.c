@@ -23,6 +23,8 @@ this program.  If not, see <http://www.gnu.org/licenses/>.  */
 #include "commands.h"
 #include "rule.h"
 #include "debug.h"
+#include "dump.h"
+#include "events.h"
 #include "getopt.h"
 
 #include <assert.h>
@@ -47,6 +49,9 @@ this program.  If not, see <http://www.gnu.org/licenses/>.  */
 #ifdef HAVE_FCNTL_H
 # include <fcntl.h>
 #endif
+#if defined(HAVE_SYS_RESOURCE_H) && defined(HAVE_GETRUSAGE)
+# include <sys/resource.h>
+#endif
 
 #ifdef _AMIGA
 int __stack = 20000; /* Make sure we have 20K of stack space */
@@ -103,6 +108,7 @@ double atof ();
 
 static void clean_jobserver (int status);
 static void print_data_base (void);
+static void print_stats (void);
 static void print_version (void);
 static void decode_switches (int argc, const char **argv, int env);
 static void decode_env_switches (const char *envar, size_t len);
@@ -188,6 +194,22 @@ static int debug_flag = 0;
 
 int db_level = 0;
 
+/* File to write the expansion profile to (--expand-profile).  */
+
+static char *expand_profile_file = 0;
+
+/* Where to write the stream of build events (--events).  */
+
+static char *events_option = 0;
+
+/* Nonzero means print internal counters on exit (--stats).  */
+
+static int stats_flag = 0;
+
+/* Nonzero means update the goals again whenever a file changes (--watch).  */
+
+int watch_flag = 0;
+
 /* Synchronize output (--output-sync).  */
 
 char *output_sync_option = 0;
@@ -206,6 +228,15 @@ int ignore_errors_flag = 0;
 
 int print_data_base_flag = 0;
 
+/* The format to print the data base in (--print-data-base=FORMAT), and
+   nonzero if that is JSON.  A JSON data base may go to a file rather than
+   stdout (--print-data-base=FORMAT:FILE); this points to its name, in
+   print_data_base_option.  */
+
+static char *print_data_base_option = 0;
+static int print_data_base_json = 0;
+static char *print_data_base_file = 0;
+
 /* Nonzero means don't remake anything; just return a nonzero status
    if the specified targets are not up to date (-q).  */
 
@@ -348,6 +379,12 @@ static const char *const usage[] =
     N_("\
   --debug[=FLAGS]             Print various types of debugging information.\n"),
     N_("\
+  --events=FILE|fd:N          Write a stream of build events to FILE or to\n\
+                              file descriptor N.\n"),
+    N_("\
+  --expand-profile=FILE       Write a profile of variable and function\n\
+                              expansions to FILE.\n"),
+    N_("\
   -e, --environment-overrides\n\
                               Environment variables override makefiles.\n"),
     N_("\
@@ -381,7 +418,9 @@ static const char *const usage[] =
   -O[TYPE], --output-sync[=TYPE]\n\
                               Synchronize output of parallel jobs by TYPE.\n"),
     N_("\
-  -p, --print-data-base       Print make's internal database.\n"),
+  -p, --print-data-base[=FORMAT[:FILE]]\n\
+                              Print make's internal database as text, json\n\
+                              or json-sorted, to stdout or FILE.\n"),
     N_("\
   -q, --question              Run no recipe; exit status says if up to date.\n"),
     N_("\
@@ -396,6 +435,8 @@ static const char *const usage[] =
   -S, --no-keep-going, --stop\n\
                               Turns off -k.\n"),
     N_("\
+  --stats                     Print internal counters on exit.\n"),
+    N_("\
   -t, --touch                 Touch targets instead of remaking them.\n"),
     N_("\
   --trace                     Print tracing information.\n"),
@@ -410,6 +451,9 @@ static const char *const usage[] =
                               Consider FILE to be infinitely new.\n"),
     N_("\
   --warn-undefined-variables  Warn when an undefined variable is referenced.\n"),
+    N_("\
+  --watch                     Update the goals again whenever a file they\n\
+                              depend on changes.\n"),
     NULL
   };
 
@@ -435,7 +479,7 @@ static const struct command_switch switches[] =
     { 'L', flag, &check_symlink_flag, 1, 1, 0, 0, 0, "check-symlink-times" },
     { 'm', ignore, 0, 0, 0, 0, 0, 0, 0 },
     { 'n', flag, &just_print_flag, 1, 1, 1, 0, 0, "just-print" },
-    { 'p', flag, &print_data_base_flag, 1, 1, 0, 0, 0, "print-data-base" },
+    { 'p', flag, &print_data_base_flag, 1, 1, 0, 0, 0, 0 },
     { 'q', flag, &question_flag, 1, 1, 1, 0, 0, "question" },
     { 'r', flag, &no_builtin_rules_flag, 1, 1, 0, 0, 0, "no-builtin-rules" },
     { 'R', flag, &no_builtin_variables_flag, 1, 1, 0, 0, 0,
@@ -473,6 +517,13 @@ static const struct command_switch switches[] =
     { CHAR_MAX+8, flag_off, &silent_flag, 1, 1, 0, 0, &default_silent_flag,
       "no-silent" },
     { CHAR_MAX+9, string, &jobserver_auth, 1, 0, 0, 0, 0, "jobserver-fds" },
+    { CHAR_MAX+10, string, &expand_profile_file, 0, 0, 0, 0, 0,
+      "expand-profile" },
+    { CHAR_MAX+11, flag, &watch_flag, 0, 0, 0, 0, 0, "watch" },
+    { CHAR_MAX+12, string, &events_option, 1, 1, 0, 0, 0, "events" },
+    { CHAR_MAX+13, flag, &stats_flag, 1, 1, 0, 0, 0, "stats" },
+    { CHAR_MAX+14, string, &print_data_base_option, 1, 1, 0, "text", 0,
+      "print-data-base" },
     { 0, 0, 0, 0, 0, 0, 0, 0, 0 }
   };
 
@@ -727,6 +778,9 @@ decode_debug_flags (void)
   if (trace_flag)
     db_level = DB_PRINT | DB_WHY;
 
+  if (expand_profile_file)
+    db_level |= DB_PROFILE;
+
   if (db_flags)
     for (pp=db_flags->list; *pp; ++pp)
       {
@@ -742,6 +796,9 @@ decode_debug_flags (void)
               case 'b':
                 db_level |= DB_BASIC;
                 break;
+              case 'e':
+                db_level |= DB_PROFILE;
+                break;
               case 'i':
                 db_level |= DB_BASIC | DB_IMPLICIT;
                 break;
@@ -813,6 +870,84 @@ decode_output_sync_flags (void)
 #endif
 }
 
+static void
+decode_print_data_base_flags (void)
+{
+  if (print_data_base_option)
+    {
+      if (streq (print_data_base_option, "text"))
+        {
+          /* This is what -p does; let that be passed on in MAKEFLAGS.  */
+          free (print_data_base_option);
+          print_data_base_option = 0;
+          print_data_base_json = 0;
+        }
+      else
+        {
+          char *colon = strchr (print_data_base_option, ':');
+          size_t len = (colon ? (size_t) (colon - print_data_base_option)
+                        : strlen (print_data_base_option));
+
+          if (len == CSTRLEN ("json")
+              && strneq (print_data_base_option, "json", len))
+            dump_sorted = 0;
+          else if (len == CSTRLEN ("json-sorted")
+                   && strneq (print_data_base_option, "json-sorted", len))
+            dump_sorted = 1;
+          else
+            OS (fatal, NILF,
+                _("unknown data base format '%s'"), print_data_base_option);
+
+          if (colon && colon[1] == '\0')
+            OS (fatal, NILF, _("no file name in --print-data-base=%s"),
+                print_data_base_option);
+
+          print_data_base_json = 1;
+          print_data_base_file = colon ? colon + 1 : 0;
+        }
+
+      print_data_base_flag = 1;
+    }
+}
+
+/* Make the name of the file in --print-data-base=FORMAT:FILE absolute, so
+   sub-makes write to the same file, and empty the file if we are the
+   top-level make.  Every make appends its data base to it as a line.  */
+
+static void
+open_print_data_base_file (unsigned int restarts)
+{
+  const char *name = print_data_base_file;
+
+  if (name[0] != '/'
+      && starting_directory && starting_directory[0] != '\0'
+#ifdef HAVE_DOS_PATHS
+      && name[0] != '\\' && name[1] != ':'
+#endif
+      )
+    {
+      size_t len = print_data_base_file - print_data_base_option;
+      char *opt = xmalloc (len + strlen (starting_directory) + 1
+                           + strlen (name) + 1);
+
+      memcpy (opt, print_data_base_option, len);
+      sprintf (opt + len, "%s/%s", starting_directory, name);
+      free (print_data_base_option);
+      print_data_base_option = opt;
+      print_data_base_file = opt + len;
+    }
+
+  if (makelevel == 0 && restarts == 0)
+    {
+      FILE *f = fopen (print_data_base_file, "w");
+
+      if (f == 0)
+        perror_with_name ("fopen: ", print_data_base_file);
+      else
+        fclose (f);
+    }
+}
+
 #ifdef WINDOWS32
 
 #ifndef NO_OUTPUT_SYNC
@@ -1409,6 +1544,17 @@ main (int argc, char **argv, char **envp)
             restarts = (unsigned int) atoi (ep);
             export = v_noexport;
           }
+        else if (!(len == 5 && strneq (envp[i], "SHELL", 5))
+#ifdef WINDOWS32
+                 && !(len == 4 && strneq (envp[i], "PATH", 4))
+#endif
+                 )
+          {
+            /* Define the rest only when they are used: most are just passed
+               on to the commands.  */
+            define_env_variable_lazily (envp[i], len);
+            continue;
+          }
 
         v = define_variable (envp[i], len, ep, o_env, 1);
 
@@ -1616,6 +1762,23 @@ main (int argc, char **argv, char **envp)
   /* We may move, but until we do, here we are.  */
   starting_directory = current_directory;
 
+  /* Open the events stream, and the file for the data base, before we move,
+     so a relative name means what the user expects.  */
+  if (print_data_base_file)
+    open_print_data_base_file (restarts);
+
+  if (events_option)
+    {
+      events_open (&events_option, restarts);
+      if (EVENTS_ENABLED)
+        {
+          event_begin ("start");
+          event_str ("directory", starting_directory);
+          event_int ("restarts", restarts);
+          event_end ();
+        }
+    }
+
   /* If there were -C flags, move ourselves about.  */
   if (directories != 0)
     {
@@ -2277,7 +2440,7 @@ main (int argc, char **argv, char **envp)
         int orig_db_level = db_level;
 
         if (! ISDB (DB_MAKEFILES))
-          db_level = DB_NONE;
+          db_level &= DB_PROFILE;
 
         rebuilding_makefiles = 1;
         status = update_goal_chain (read_files);
@@ -2421,6 +2584,14 @@ main (int argc, char **argv, char **envp)
 
           ++restarts;
 
+          if (EVENTS_ENABLED)
+            {
+              event_begin ("restart");
+              event_int ("restarts", restarts);
+              event_end ();
+              events_close ();
+            }
+
           if (ISDB (DB_BASIC))
             {
               const char **p;
@@ -2610,6 +2781,10 @@ main (int argc, char **argv, char **envp)
 
   DB (DB_BASIC, (_("Updating goal targets....\n")));
 
+  /* A failed recipe must not end a --watch session.  */
+  if (watch_flag)
+    keep_going_flag = 1;
+
   {
     switch (update_goal_chain (goals))
     {
@@ -2634,6 +2809,9 @@ main (int argc, char **argv, char **envp)
       O (error, NILF,
          _("warning:  Clock skew detected.  Your build may be incomplete."));
 
+    if (watch_flag)
+      watch_goal_chain (goals, read_files);
+
     /* Exit.  */
     die (makefile_status);
   }
@@ -3033,6 +3211,7 @@ decode_switches (int argc, const char **argv, int env)
   /* If there are any options that need to be decoded do it now.  */
   decode_debug_flags ();
   decode_output_sync_flags ();
+  decode_print_data_base_flags ();
 
   /* Perform any special switch handling.  */
   run_silent = silent_flag;
@@ -3415,7 +3594,35 @@ print_version (void)
 static void
 print_data_base (void)
 {
-  time_t when = time ((time_t *) 0);
+  time_t when;
+
+  if (print_data_base_json)
+    {
+      FILE *out = stdout;
+
+      if (print_data_base_file)
+        {
+          out = fopen (print_data_base_file, "a");
+          if (out == 0)
+            {
+              perror_with_name ("fopen: ", print_data_base_file);
+              return;
+            }
+        }
+
+      dump_begin (out);
+      dump_str ("version", version_string);
+      dump_variable_data_base ();
+      dump_rule_data_base ();
+      dump_file_data_base ();
+      dump_end ();
+
+      if (out != stdout)
+        fclose (out);
+      return;
+    }
+
+  when = time ((time_t *) 0);
 
   print_version ();
 
@@ -3432,6 +3639,54 @@ print_data_base (void)
   printf (_("\n# Finished Make data base on %s\n"), ctime (&when));
 }
 
+/* Print the counters collected for --stats.  */
+
+static void
+print_stats (void)
+{
+  unsigned int i;
+
+  puts (_("\n# Make statistics"));
+
+  print_file_stats ();
+  print_variable_stats ();
+  print_dir_stats ();
+  strcache_print_stats ("#");
+
+  printf (_("\n# stat calls: %lu\n"), make_stats.stats);
+  printf (_("# opendir calls: %lu\n"), make_stats.opendirs);
+  printf (_("# readdir calls: %lu\n"), make_stats.readdirs);
+  printf (_("# implicit rule searches: %lu (pattern rules tried: %lu)\n"),
+          make_stats.pattern_searches, make_stats.pattern_rules);
+  printf (_("# variable references: %lu\n"), make_stats.variable_refs);
+  printf (_("# function calls: %lu\n"), make_stats.function_calls);
+  printf (_("# shell function processes: %lu\n"), make_stats.shells);
+  printf (_("# recipe processes: %lu\n"), make_stats.spawns);
+
+  if (make_stats.shells || make_stats.spawns)
+    puts (_("# process start times (microseconds):"));
+  for (i = 0; i < STATS_LATENCY_BUCKETS; ++i)
+    if (make_stats.latency[i])
+      printf ("#   %8lu - %-8lu %lu\n", i ? 1UL << i : 0UL,
+              (1UL << (i + 1)) - 1, make_stats.latency[i]);
+
+#if defined(HAVE_SYS_RESOURCE_H) && defined(HAVE_GETRUSAGE)
+  {
+    struct rusage ru;
+
+    if (getrusage (RUSAGE_SELF, &ru) == 0)
+# ifdef __APPLE__
+      /* macOS reports it in bytes.  */
+      printf (_("# peak resident set size: %ld kB\n"), ru.ru_maxrss / 1024);
+# else
+      printf (_("# peak resident set size: %ld kB\n"), ru.ru_maxrss);
+# endif
+  }
+#endif
+
+  fflush (stdout);
+}
+
 static void
 clean_jobserver (int status)
 {
@@ -3499,9 +3754,23 @@ die (int status)
       if (print_data_base_flag)
         print_data_base ();
 
+      if (ISDB (DB_PROFILE))
+        print_expand_profile (expand_profile_file);
+
+      if (stats_flag)
+        print_stats ();
+
       if (verify_flag)
         verify_file_data_base ();
 
+      if (EVENTS_ENABLED)
+        {
+          event_begin ("finish");
+          event_int ("status", status);
+          event_end ();
+          events_close ();
+        }
+
       clean_jobserver (status);
 
       if (output_context)
@@ -548,6 +548,34 @@ const char *find_percent_cached (const char **);
 FILE *get_tmpfile (char **, const char *);
 ssize_t writebuf (int, const void *, size_t);
 ssize_t readbuf (int, void *, size_t);
+double clock_seconds (void);
+
+/* Counters reported by --stats.  Make runs in a single thread, so these
+   are plain integers and counting an event costs one increment.  */
+
+#define STATS_LATENCY_BUCKETS 24
+
+struct make_stats
+  {
+    unsigned long stats;            /* stat() and lstat() calls.  */
+    unsigned long opendirs;         /* opendir() calls.  */
+    unsigned long readdirs;         /* readdir() calls.  */
+    unsigned long pattern_searches; /* Implicit rule searches.  */
+    unsigned long pattern_rules;    /* Pattern rules tried by those.  */
+    unsigned long variable_refs;    /* Variable references expanded.  */
+    unsigned long function_calls;   /* Make functions called.  */
+    unsigned long shells;           /* $(shell ...) processes started.  */
+    unsigned long spawns;           /* Recipe processes started.  */
+    /* Time taken to start each process: bucket N counts the starts which
+       took less than 2^(N+1) microseconds and no less than 2^N.  */
+    unsigned long latency[STATS_LATENCY_BUCKETS];
+  };
+
+extern struct make_stats make_stats;
+
+#define STATS_COUNT(_c)  (++make_stats._c)
+
+void stats_process_started (double start);
 
 #ifndef HAVE_MEMRCHR
 void *memrchr(const void *, int, size_t);
@@ -558,6 +586,8 @@ int ar_name (const char *);
 void ar_parse_name (const char *, char **, char **);
 int ar_touch (const char *);
 time_t ar_member_date (const char *);
+void ar_forget (const char *);
+void ar_notice_update (const char *);
 
 typedef long int (*ar_member_func_t) (int desc, const char *mem, int truncated,
                                       long int hdrpos, long int datapos,
@@ -568,6 +598,7 @@ typedef long int (*ar_member_func_t) (int desc, const char *mem, int truncated,
 long int ar_scan (const char *archive, ar_member_func_t function, const void *arg);
 int ar_name_equal (const char *name, const char *mem, int truncated);
 #ifndef VMS
+int ar_name_truncated (const char *mem, int truncated);
 int ar_member_touch (const char *arname, const char *memname);
 #endif
 #endif
@@ -578,6 +609,7 @@ int file_impossible_p (const char *);
 void file_impossible (const char *);
 const char *dir_name (const char *);
 void print_dir_data_base (void);
+void print_dir_stats (void);
 void dir_setup_glob (glob_t *);
 void hash_init_directories (void);
 
@@ -689,6 +721,7 @@ extern int print_version_flag, print_directory, check_symlink_flag;
 extern int warn_undefined_variables_flag, posix_pedantic;
 extern int not_parallel, second_expansion, clock_skew_detected;
 extern int rebuilding_makefiles, one_shell, output_sync, verify_flag;
+extern int watch_flag;
 extern unsigned long command_count;
 
 extern const char *default_shell;
@@ -739,17 +772,21 @@ vms_restore_symbol (const char *string);
 void remote_setup (void);
 void remote_cleanup (void);
 int start_remote_job_p (int);
-int start_remote_job (char **, char **, int, int *, pid_t *, int *);
+int start_remote_job (char **, char **, int, int, int, int *, pid_t *, int *);
 int remote_status (int *, int *, int *, int);
+unsigned int remote_status_fds (int *, unsigned int);
 void block_remote_children (void);
 void unblock_remote_children (void);
 int remote_kill (pid_t id, int sig);
 void print_variable_data_base (void);
+void dump_variable_data_base (void);
+void print_variable_stats (void);
 void print_vpath_data_base (void);
 
 extern char *starting_directory;
 extern unsigned int makelevel;
-extern char *version_string, *remote_description, *make_host;
+extern char *version_string, *make_host;
+extern const char *remote_description;
 
 extern unsigned int commands_started;
 
@@ -828,6 +828,51 @@ child_access (void)
 #endif  /* GETLOADAVG_PRIVILEGED */
 }
 
+/* Return the current time in seconds, with as much precision as the system
+   provides.  The value is only useful for measuring elapsed time: it is
+   taken from a monotonic clock when one is available.  */
+
+double
+clock_seconds (void)
+{
+#if HAVE_CLOCK_GETTIME && defined CLOCK_MONOTONIC
+  struct timespec ts;
+  if (clock_gettime (CLOCK_MONOTONIC, &ts) == 0)
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+#endif
+#if HAVE_GETTIMEOFDAY
+  {
+    struct timeval tv;
+    if (gettimeofday (&tv, 0) == 0)
+      return tv.tv_sec + tv.tv_usec / 1e6;
+  }
+#endif
+  {
+    time_t now = time ((time_t *) 0);
+    return (double) now;
+  }
+}
+
+struct make_stats make_stats;
+
+/* Note that a process was started, which began at START (as returned by
+   clock_seconds()).  */
+
+void
+stats_process_started (double start)
+{
+  double usec = (clock_seconds () - start) * 1e6;
+  unsigned int i = 0;
+
+  while (usec >= 2 && i < STATS_LATENCY_BUCKETS - 1)
+    {
+      usec /= 2;
+      ++i;
+    }
+
+  ++make_stats.latency[i];
+}
+
 #ifdef NEED_GET_PATH_MAX
 unsigned int
 get_path_max (void)
@@ -76,6 +76,14 @@ unsigned int jobserver_acquire (int timeout);
 
 #endif
 
+/* Sleep until a local child exits or a remote child may have finished.
+   It may return early, so the caller must check for both afterward.  */
+#if defined(VMS) || defined(WINDOWS32) || defined(_AMIGA) || defined(__MSDOS__)
+# define os_wait_for_children() (void)(0)
+#else
+void os_wait_for_children (void);
+#endif
+
 /* Create a "bad" file descriptor for stdin when parallel jobs are run.  */
 #if defined(VMS) || defined(WINDOWS32) || defined(_AMIGA) || defined(__MSDOS__)
 # define get_bad_stdin() (-1)
@@ -91,3 +99,12 @@ int get_bad_stdin (void);
 void fd_inherit (int);
 void fd_noinherit (int);
 #endif
+
+/* Block until something changes in one of the directories DIRS, or until
+   TIMEOUT seconds have passed.  Returns 0 if change notification is not
+   available and the caller must poll instead.  */
+#if defined(HAVE_SYS_INOTIFY_H)
+int os_wait_for_change (const char **dirs, unsigned int count, int timeout);
+#else
+# define os_wait_for_change(_d,_c,_t) (0)
+#endif
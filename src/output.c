@@ -370,8 +370,10 @@ output_dump (struct output *out)
          We want to keep this lock for as little time as possible.  */
       void *sem = acquire_semaphore ();
 
-      /* Log the working directory for this dump.  */
-      if (print_directory && output_sync != OUTPUT_SYNC_RECURSE)
+      /* Log the working directory for this dump.  If output isn't being
+         synchronized the directory has been logged already.  */
+      if (print_directory && output_sync != OUTPUT_SYNC_NONE
+          && output_sync != OUTPUT_SYNC_RECURSE)
         traced = log_working_directory (1);
 
       if (outfd_not_empty)
@@ -32,6 +32,61 @@ this program.  If not, see <http://www.gnu.org/licenses/>.  */
 #include "job.h"
 #include "os.h"
 
+/* Add the descriptors that tell us a remote child may have finished to SET,
+   and return the highest of them and MAXFD.  */
+
+static int
+add_remote_fds (fd_set *set, int maxfd)
+{
+  int fds[FD_SETSIZE];
+  unsigned int i, n = remote_status_fds (fds, FD_SETSIZE);
+
+  for (i = 0; i < n; ++i)
+    if (fds[i] < FD_SETSIZE)
+      {
+        FD_SET (fds[i], set);
+        if (fds[i] > maxfd)
+          maxfd = fds[i];
+      }
+
+  return maxfd;
+}
+
+/* Sleep until a local child exits or a remote child may have finished.
+   With pselect() SIGCHLD is blocked everywhere else, so a child that died
+   before we got here still interrupts the wait.  The timeout covers
+   systems where SIGCHLD does not interrupt select().  */
+
+void
+os_wait_for_children (void)
+{
+  fd_set readfds;
+  int maxfd;
+
+  FD_ZERO (&readfds);
+  maxfd = add_remote_fds (&readfds, -1);
+
+#ifdef HAVE_PSELECT
+  {
+    struct timespec spec;
+    sigset_t empty;
+
+    sigemptyset (&empty);
+    spec.tv_sec = 1;
+    spec.tv_nsec = 0;
+    pselect (maxfd + 1, &readfds, NULL, NULL, &spec, &empty);
+  }
+#else
+  {
+    struct timeval tv;
+
+    tv.tv_sec = 1;
+    tv.tv_usec = 0;
+    select (maxfd + 1, &readfds, NULL, NULL, &tv);
+  }
+#endif
+}
+
 #ifdef MAKE_JOBSERVER
 
 /* This section provides OS-specific functions to support the jobserver.  */
@@ -285,13 +340,16 @@ jobserver_acquire (int timeout)
   while (1)
     {
       fd_set readfds;
-      int r;
+      int r, maxfd;
       char intake;
 
       FD_ZERO (&readfds);
       FD_SET (job_fds[0], &readfds);
 
-      r = pselect (job_fds[0]+1, &readfds, NULL, NULL, specp, &empty);
+      /* Wake up for remote children too, so they can be reaped.  */
+      maxfd = add_remote_fds (&readfds, job_fds[0]);
+
+      r = pselect (maxfd+1, &readfds, NULL, NULL, specp, &empty);
       if (r < 0)
         switch (errno)
           {
@@ -312,6 +370,10 @@ jobserver_acquire (int timeout)
         /* Timeout.  */
         return 0;
 
+      if (!FD_ISSET (job_fds[0], &readfds))
+        /* A remote child needs attention.  */
+        return 0;
+
       /* The read FD is ready: read it!  This is non-blocking.  */
       EINTRLOOP (r, read (job_fds[0], &intake, 1));
 
@@ -515,3 +577,47 @@ fd_noinherit (int fd)
       }
 }
 #endif
+
+#ifdef HAVE_SYS_INOTIFY_H
+
+#include <sys/inotify.h>
+#include <poll.h>
+
+/* Wait for a change in any of the directories DIRS, or TIMEOUT seconds.
+   A new inotify instance is used each time because the set of directories
+   may differ between calls, and watches are cheap to set up.  */
+int
+os_wait_for_change (const char **dirs, unsigned int count, int timeout)
+{
+  const uint32_t mask = (IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM
+                         | IN_CREATE | IN_DELETE | IN_ATTRIB);
+  struct pollfd pfd;
+  unsigned int i, watched = 0;
+  int fd, r;
+
+  EINTRLOOP (fd, inotify_init ());
+  if (fd < 0)
+    return 0;
+  fd_noinherit (fd);
+
+  for (i = 0; i < count; ++i)
+    if (inotify_add_watch (fd, dirs[i], mask) >= 0)
+      ++watched;
+
+  /* If nothing could be watched (say, we ran out of watches) let the
+     caller fall back to polling.  */
+  if (watched == 0)
+    {
+      close (fd);
+      return 0;
+    }
+
+  pfd.fd = fd;
+  pfd.events = POLLIN;
+  EINTRLOOP (r, poll (&pfd, 1, timeout * 1000));
+
+  close (fd);
+  return 1;
+}
+
+#endif /* HAVE_SYS_INOTIFY_H */
@@ -21,6 +21,8 @@ this program.  If not, see <http://www.gnu.org/licenses/>.  */
 #include "dep.h"
 #include "variable.h"
 #include "debug.h"
+#include "events.h"
+#include "os.h"
 
 #include <assert.h>
 
@@ -61,6 +63,18 @@ static struct dep *goal_dep;
    All files start with considered == 0.  */
 static unsigned int considered = 0;
 
+/* Timestamp hooks registered by loaded objects, in order.  */
+
+struct mtime_hook
+  {
+    struct mtime_hook *next;
+    const char *pattern;        /* Files to ask about, or NULL for all.  */
+    const char *percent;        /* The '%' in PATTERN, if any.  */
+    gmk_mtime_func_ptr func;
+  };
+
+static struct mtime_hook *mtime_hooks = 0;
+
 static enum update_status update_file (struct file *file, unsigned int depth);
 static enum update_status update_file_1 (struct file *file, unsigned int depth);
 static enum update_status check_dep (struct file *file, unsigned int depth,
@@ -69,6 +83,9 @@ static enum update_status touch_file (struct file *file);
 static void remake_file (struct file *file);
 static FILE_TIMESTAMP name_mtime (const char *name);
 static const char *library_search (const char *lib, FILE_TIMESTAMP *mtime_ptr);
+static void ask_mtime_hooks_for_deps (struct file *file);
+static const char *update_status_name (enum update_status status);
+static void implicit_rule_event (struct file *file, int found);
 
 
 /* Remake all the goals in the 'struct dep' chain GOALS.  Return -1 if nothing
@@ -97,6 +114,18 @@ update_goal_chain (struct goaldep *goaldeps)
   /* Start a fresh batch of consideration.  */
   ++considered;
 
+  if (EVENTS_ENABLED)
+    {
+      struct dep *g;
+      for (g = goals; g != 0; g = g->next)
+        {
+          event_begin ("goal-start");
+          event_str ("target", g->file->name);
+          event_bool ("makefile", rebuilding_makefiles);
+          event_end ();
+        }
+    }
+
   /* Update all the goals until they are all finished.  */
 
   while (goals != 0)
@@ -227,6 +256,16 @@ update_goal_chain (struct goaldep *goaldeps)
                                  : _("'%s' is up to date.")),
                     file->name);
 
+              if (EVENTS_ENABLED)
+                {
+                  event_begin ("goal-finish");
+                  event_str ("target", file->name);
+                  event_bool ("makefile", rebuilding_makefiles);
+                  event_str ("status", update_status_name (file->update_status));
+                  event_bool ("changed", g->changed);
+                  event_end ();
+                }
+
               /* This goal is finished.  Remove it from the chain.  */
               if (lastgoal == 0)
                 goals = g->next;
@@ -288,6 +327,305 @@ show_goal_error (void)
       }
 }
 
+/* Support for --watch.  Once the goals are up to date, remember the
+   modification time of every file the update looked at, wait for one of
+   them to change, then forget what we know about all files and update the
+   goals again.  */
+
+/* How long to wait for a change notification before checking anyway.  */
+#define WATCH_TIMEOUT 10
+
+struct watched_file
+  {
+    struct file *file;
+    FILE_TIMESTAMP mtime;
+  };
+
+static struct watched_file *watched = 0;
+static unsigned int watched_count = 0;
+static unsigned int watched_max = 0;
+
+/* Remember F and its current modification time.  */
+
+static void
+add_watched_file (struct file *f)
+{
+  if (f->phony || f->renamed != 0
+#ifndef NO_ARCHIVES
+      || ar_name (f->name)
+#endif
+      )
+    return;
+
+  if (watched_count == watched_max)
+    {
+      watched_max = watched_max ? watched_max * 2 : 64;
+      watched = xrealloc (watched, watched_max * sizeof (struct watched_file));
+    }
+
+  watched[watched_count].file = f;
+  watched[watched_count].mtime = name_mtime (f->name);
+  ++watched_count;
+}
+
+/* Remember FILE if the last update of the goals looked at it.  */
+
+static void
+watch_file (const void *item, void *arg UNUSED)
+{
+  struct file *f = (struct file *) item;
+
+  if (f->updated)
+    add_watched_file (f);
+}
+
+/* Return the directories containing the watched files, without duplicates.
+   Store the number of directories in *COUNT.  */
+
+static const char **
+watched_dirs (unsigned int *count)
+{
+  const char **dirs = xmalloc ((watched_count + 1) * sizeof (const char *));
+  unsigned int i, j, n = 0;
+
+  for (i = 0; i < watched_count; ++i)
+    {
+      const char *name = watched[i].file->name;
+      const char *slash = strrchr (name, '/');
+      const char *dir;
+
+      if (slash == 0)
+        dir = strcache_add (".");
+      else if (slash == name)
+        dir = strcache_add ("/");
+      else
+        dir = strcache_add_len (name, slash - name);
+
+      /* Strings in the cache are unique, so compare pointers.  */
+      for (j = 0; j < n; ++j)
+        if (dirs[j] == dir)
+          break;
+      if (j == n)
+        dirs[n++] = dir;
+    }
+
+  *count = n;
+  return dirs;
+}
+
+/* Implicit rule search must be done again in each round, since the files
+   it looked for may have been created or removed.  Each file a search
+   changes is recorded here first, newest first, so that the search can be
+   undone before the next round.  */
+
+struct implicit_undo
+  {
+    struct implicit_undo *next;
+    struct file *file;
+    struct dep *deps;
+    struct dep *also_make;
+    struct commands *cmds;
+    const char *stem;
+    struct variable_set_list *variables;
+    struct variable_set_list *pat_variables;
+    unsigned int entered:1;
+    unsigned int is_target:1;
+    unsigned int intermediate:1;
+    unsigned int secondary:1;
+    unsigned int notintermediate:1;
+    unsigned int precious:1;
+    unsigned int cacheable:1;
+    unsigned int tried_implicit:1;
+    unsigned int pat_searched:1;
+  };
+
+static struct implicit_undo *implicit_undo = 0;
+
+/* Remember what FILE looks like before implicit rule search changes it.
+   ENTERED is nonzero if the search entered FILE in the data base.  Only
+   --watch needs this.  */
+
+void
+note_implicit_search (struct file *file, int entered)
+{
+  struct implicit_undo *u;
+
+  if (!watch_flag)
+    return;
+
+  u = xmalloc (sizeof (struct implicit_undo));
+  u->file = file;
+  u->deps = file->deps;
+  u->also_make = file->also_make;
+  u->cmds = file->cmds;
+  u->stem = file->stem;
+  u->variables = file->variables;
+  u->pat_variables = file->pat_variables;
+  u->entered = entered;
+  u->is_target = file->is_target;
+  u->intermediate = file->intermediate;
+  u->secondary = file->secondary;
+  u->notintermediate = file->notintermediate;
+  u->precious = file->precious;
+  u->cacheable = file->cacheable;
+  u->tried_implicit = file->tried_implicit;
+  u->pat_searched = file->pat_searched;
+
+  u->next = implicit_undo;
+  implicit_undo = u;
+}
+
+/* Undo every implicit rule search since the last call.  A search only adds
+   prerequisites to the front of the lists, so free those ahead of the
+   recorded ones.  */
+
+static void
+undo_implicit_searches (void)
+{
+  while (implicit_undo != 0)
+    {
+      struct implicit_undo *u = implicit_undo;
+      struct file *f = u->file;
+
+      while (f->deps != 0 && f->deps != u->deps)
+        {
+          struct dep *d = f->deps;
+          f->deps = d->next;
+          free_dep (d);
+        }
+      while (f->also_make != 0 && f->also_make != u->also_make)
+        {
+          struct dep *d = f->also_make;
+          f->also_make = d->next;
+          free_dep (d);
+        }
+
+      f->deps = u->deps;
+      f->also_make = u->also_make;
+      f->cmds = u->cmds;
+      f->stem = u->stem;
+      f->variables = u->variables;
+      f->pat_variables = u->pat_variables;
+      f->search_undone = u->entered;
+      f->is_target = u->is_target;
+      f->intermediate = u->intermediate;
+      f->secondary = u->secondary;
+      f->notintermediate = u->notintermediate;
+      f->precious = u->precious;
+      f->cacheable = u->cacheable;
+      f->tried_implicit = u->tried_implicit;
+      f->pat_searched = u->pat_searched;
+
+      implicit_undo = u->next;
+      free (u);
+    }
+}
+
+/* Forget everything the last update learned about FILE and its
+   double-colon entries.  Files given with -o or -W keep their fake
+   modification times.  */
+
+static void
+reset_file (const void *item, void *arg UNUSED)
+{
+  struct file *f = (struct file *) item;
+
+  for (f = f->double_colon ? f->double_colon : f; f != 0; f = f->prev)
+    {
+      f->updated = 0;
+      f->update_status = us_none;
+      f->command_state = cs_not_started;
+      f->mtime_hooked = 0;
+      f->hook_uptodate = 0;
+      f->hook_mtime = UNKNOWN_MTIME;
+
+      if (f->mtime_before_update == OLD_MTIME
+          || f->mtime_before_update == NEW_MTIME)
+        f->last_mtime = f->mtime_before_update;
+      else
+        f->last_mtime = f->mtime_before_update = UNKNOWN_MTIME;
+    }
+}
+
+/* Update GOALS again each time one of the files they depend on changes.
+   MAKEFILES are the makefiles that were read; they are watched too but not
+   re-read, so warn when one of them changes.  Never returns.  */
+
+void
+watch_goal_chain (struct goaldep *goals, struct goaldep *makefiles)
+{
+  while (1)
+    {
+      const char **dirs;
+      FILE_TIMESTAMP *dir_mtimes;
+      struct goaldep *m;
+      unsigned int ndirs, i;
+      int changed = 0;
+
+      watched_count = 0;
+      map_files (watch_file, NULL);
+      for (m = makefiles; m != 0; m = m->next)
+        if (!m->file->updated)
+          add_watched_file (m->file);
+      dirs = watched_dirs (&ndirs);
+
+      /* A file created or removed in one of the directories may change the
+         result of implicit rule search.  */
+      dir_mtimes = xmalloc ((ndirs + 1) * sizeof (FILE_TIMESTAMP));
+      for (i = 0; i < ndirs; ++i)
+        dir_mtimes[i] = name_mtime (dirs[i]);
+
+      ON (message, 1, _("Watching %u files for changes..."), watched_count);
+
+      while (!changed)
+        {
+          if (!os_wait_for_change (dirs, ndirs, WATCH_TIMEOUT))
+#ifdef WINDOWS32
+            Sleep (1000);
+#else
+            sleep (1);
+#endif
+
+          for (i = 0; i < watched_count; ++i)
+            {
+              struct file *f = watched[i].file;
+
+              if (name_mtime (f->name) == watched[i].mtime)
+                continue;
+
+              DB (DB_BASIC, (_("File '%s' has changed.\n"), f->name));
+              changed = 1;
+
+              for (m = makefiles; m != 0; m = m->next)
+                if (m->file == f)
+                  OS (error, NILF,
+                      _("warning: makefile '%s' has changed but is not re-read"),
+                      f->name);
+            }
+
+          for (i = 0; i < ndirs; ++i)
+            if (name_mtime (dirs[i]) != dir_mtimes[i])
+              {
+                DB (DB_BASIC, (_("Directory '%s' has changed.\n"), dirs[i]));
+                changed = 1;
+              }
+        }
+
+      free (dir_mtimes);
+      free (dirs);
+
+      /* Files may have been created or removed: forget the cached
+         directory contents.  */
+      ++command_count;
+
+      undo_implicit_searches ();
+      map_files (reset_file, NULL);
+
+      DB (DB_BASIC, (_("Updating goal targets....\n")));
+      update_goal_chain (goals);
+    }
+}
+
 /* If FILE is not up to date, execute the commands for it.
    Return 0 if successful, non-0 if unsuccessful;
    but with some flag settings, just call 'exit' if unsuccessful.
@@ -473,6 +811,9 @@ update_file_1 (struct file *file, unsigned int depth)
      remember this one to turn off updating.  */
   ofile = file;
 
+  if (mtime_hooks != 0)
+    ask_mtime_hooks_for_deps (file);
+
   /* Looking at the file's modtime beforehand allows the possibility
      that its name may be changed by a VPATH search, and thus it may
      not need an implicit rule.  If this were not done, the file
@@ -503,10 +844,12 @@ update_file_1 (struct file *file, unsigned int depth)
 
   if (!file->phony && file->cmds == 0 && !file->tried_implicit)
     {
-      if (try_implicit_rule (file, depth))
+      int found = try_implicit_rule (file, depth);
+      if (found)
         DBF (DB_IMPLICIT, _("Found an implicit rule for '%s'.\n"));
       else
         DBF (DB_IMPLICIT, _("No implicit rule found for '%s'.\n"));
+      implicit_rule_event (file, found);
       file->tried_implicit = 1;
     }
   if (file->cmds == 0 && !file->is_target
@@ -527,6 +870,7 @@ update_file_1 (struct file *file, unsigned int depth)
   while (ad)
     {
       struct dep *lastd = 0;
+      int serial = ad->file->notparallel;
 
       /* Find the deps we're scanning */
       d = ad->file->deps;
@@ -539,6 +883,11 @@ update_file_1 (struct file *file, unsigned int depth)
           int maybe_make;
           int dontcare = 0;
 
+          /* Under .NOTPARALLEL, or at a .WAIT, start nothing while a
+             prerequisite before this one runs.  */
+          if (running && (serial || d->wait_here))
+            break;
+
           check_renamed (d->file);
 
           mtime = file_mtime (d->file);
@@ -620,7 +969,12 @@ update_file_1 (struct file *file, unsigned int depth)
             enum update_status new;
             int dontcare = 0;
 
-            FILE_TIMESTAMP mtime = file_mtime (d->file);
+            FILE_TIMESTAMP mtime;
+
+            if (running && (file->notparallel || d->wait_here))
+              break;
+
+            mtime = file_mtime (d->file);
             check_renamed (d->file);
             d->file->parent = file;
 
@@ -794,6 +1148,12 @@ update_file_1 (struct file *file, unsigned int depth)
       DBF (DB_VERBOSE, _("Making '%s' due to always-make flag.\n"));
     }
 
+  if (must_make && file->hook_uptodate && !always_make_flag)
+    {
+      must_make = 0;
+      DBF (DB_BASIC, _("A timestamp hook says '%s' is up to date.\n"));
+    }
+
   if (!must_make)
     {
       if (ISDB (DB_VERBOSE))
@@ -821,6 +1181,15 @@ update_file_1 (struct file *file, unsigned int depth)
       return 0;
     }
 
+  /* If FILE's resource pool is full, wait for one of its recipes to finish
+     as we would for a prerequisite, without holding a job slot.  */
+  if (!pool_available (file))
+    {
+      set_command_state (file, cs_deps_running);
+      DBF (DB_VERBOSE, _("Waiting for the resource pool of '%s'.\n"));
+      return 0;
+    }
+
   DBF (DB_BASIC, _("Must remake target '%s'.\n"));
 
   /* It needs to be remade.  If it's VPATH and not reset via GPATH, toss the
@@ -870,11 +1239,18 @@ notice_finished_file (struct file *file)
 {
   struct dep *d;
   int ran = file->command_state == cs_running;
+  int again = file->command_state == cs_finished;
   int touched = 0;
 
   file->command_state = cs_finished;
   file->updated = 1;
 
+#ifndef NO_ARCHIVES
+  /* The recipe may have changed an archive; update what we knew of it.  */
+  if (ran)
+    ar_notice_update (file->name);
+#endif
+
   if (touch_flag
       /* The update status will be:
            us_success   if 0 or more commands (+ or ${MAKE}) were run and won;
@@ -993,6 +1369,16 @@ notice_finished_file (struct file *file)
     /* Nothing was done for FILE, but it needed nothing done.
        So mark it now as "succeeded".  */
     file->update_status = us_success;
+
+  /* We may be told more than once; report the first.  */
+  if (EVENTS_ENABLED && !again)
+    {
+      event_begin ("target-finish");
+      event_str ("target", file->name);
+      event_str ("status", update_status_name (file->update_status));
+      event_bool ("ran", ran || touched);
+      event_end ();
+    }
 }
 
 /* Check whether another file (whose mtime is THIS_MTIME) needs updating on
@@ -1035,10 +1421,12 @@ check_dep (struct file *file, unsigned int depth,
 
       if (!file->phony && file->cmds == 0 && !file->tried_implicit)
         {
-          if (try_implicit_rule (file, depth))
+          int found = try_implicit_rule (file, depth);
+          if (found)
             DBF (DB_IMPLICIT, _("Found an implicit rule for '%s'.\n"));
           else
             DBF (DB_IMPLICIT, _("No implicit rule found for '%s'.\n"));
+          implicit_rule_event (file, found);
           file->tried_implicit = 1;
         }
       if (file->cmds == 0 && !file->is_target
@@ -1243,6 +1631,139 @@ remake_file (struct file *file)
   notice_finished_file (file);
 }
 
+void
+define_mtime_hook (const char *pattern, gmk_mtime_func_ptr func)
+{
+  struct mtime_hook *hook = xmalloc (sizeof (struct mtime_hook));
+  struct mtime_hook **hp;
+
+  hook->next = 0;
+  hook->pattern = pattern && *pattern ? strcache_add (pattern) : 0;
+  hook->percent = hook->pattern ? strchr (hook->pattern, '%') : 0;
+  hook->func = func;
+
+  for (hp = &mtime_hooks; *hp != 0; hp = &(*hp)->next)
+    ;
+  *hp = hook;
+}
+
+/* Return nonzero if the timestamp hooks should be asked about FILE.  */
+
+static int
+want_mtime_hook (const struct file *file)
+{
+  return (!file->mtime_hooked && file->last_mtime == UNKNOWN_MTIME
+#ifndef NO_ARCHIVES
+          && !ar_name (file->name)
+#endif
+          );
+}
+
+/* Ask the timestamp hooks about the COUNT files in FILES in one go, and
+   remember their answers in each file.  FILES is overwritten.  */
+
+static void
+ask_mtime_hooks (struct file **files, unsigned int count)
+{
+  struct mtime_hook *hook;
+  gmk_mtime *q;
+  unsigned int *qi;
+  unsigned int i;
+
+  for (i = 0; i < count; ++i)
+    files[i]->mtime_hooked = 1;
+
+  q = xmalloc (count * sizeof (gmk_mtime));
+  qi = xmalloc (count * sizeof (unsigned int));
+
+  for (hook = mtime_hooks; hook != 0; hook = hook->next)
+    {
+      unsigned int n = 0;
+
+      for (i = 0; i < count; ++i)
+        if (files[i] != 0
+            && (hook->pattern == 0
+                || pattern_matches (hook->pattern, hook->percent,
+                                    files[i]->name)))
+          {
+            q[n].name = files[i]->name;
+            q[n].status = GMK_MTIME_DEFAULT;
+            q[n].sec = 0;
+            q[n].nsec = 0;
+            qi[n++] = i;
+          }
+
+      if (n == 0)
+        continue;
+
+      DB (DB_VERBOSE,
+          (_("Asking a timestamp hook about %u files.\n"), n));
+      hook->func (n, q);
+
+      for (i = 0; i < n; ++i)
+        {
+          struct file *f = files[qi[i]];
+
+          switch (q[i].status)
+            {
+            case GMK_MTIME_SET:
+              f->hook_mtime = file_timestamp_cons (f->name, q[i].sec,
+                                                   q[i].nsec);
+              break;
+            case GMK_MTIME_MISSING:
+              f->hook_mtime = NONEXISTENT_MTIME;
+              break;
+            case GMK_MTIME_UPTODATE:
+              f->hook_uptodate = 1;
+              break;
+            default:
+              continue;
+            }
+
+          /* Later hooks are not asked about files that have an answer.  */
+          files[qi[i]] = 0;
+        }
+    }
+
+  free (qi);
+  free (q);
+}
+
+/* Ask the timestamp hooks about FILE and its prerequisites, so that they
+   can answer for all of them at once.  */
+
+static void
+ask_mtime_hooks_for_deps (struct file *file)
+{
+  struct file **files;
+  unsigned int count = 0;
+  struct dep *d;
+
+  for (d = file->deps; d != 0; d = d->next)
+    ++count;
+
+  files = xmalloc ((count + 1) * sizeof (struct file *));
+  count = 0;
+
+  if (want_mtime_hook (file))
+    {
+      file->mtime_hooked = 1;
+      files[count++] = file;
+    }
+  for (d = file->deps; d != 0; d = d->next)
+    if (want_mtime_hook (d->file))
+      {
+        /* A file may be listed more than once.  */
+        d->file->mtime_hooked = 1;
+        files[count++] = d->file;
+      }
+
+  if (count)
+    ask_mtime_hooks (files, count);
+
+  free (files);
+}
+
 /* Return the mtime of a file, given a 'struct file'.
    Caches the time in the struct file to avoid excess stat calls.
 
@@ -1321,7 +1842,18 @@ f_mtime (struct file *file, int search)
   else
 #endif
     {
-      mtime = name_mtime (file->name);
+      /* A timestamp from a hook is used once: if the file is remade, its
+         new time comes from the system.  */
+      if (mtime_hooks != 0 && want_mtime_hook (file))
+        {
+          struct file *f = file;
+          ask_mtime_hooks (&f, 1);
+        }
+      mtime = file->hook_mtime;
+      file->hook_mtime = UNKNOWN_MTIME;
+
+      if (mtime == UNKNOWN_MTIME)
+        mtime = name_mtime (file->name);
 
       if (mtime == NONEXISTENT_MTIME && search && !file->ignore_vpath)
         {
@@ -1498,6 +2030,7 @@ name_mtime (const char *name)
         tend = &tem[0];
       }
 
+    STATS_COUNT (stats);
     e = stat (tem, &st);
     if (e == 0 && !_S_ISDIR (st.st_mode) && tend < tem + (p - name - 1))
       {
@@ -1506,6 +2039,7 @@ name_mtime (const char *name)
       }
   }
 #else
+  STATS_COUNT (stats);
   EINTRLOOP (e, stat (name, &st));
 #endif
   if (e == 0)
@@ -1543,6 +2077,7 @@ name_mtime (const char *name)
           long llen;
           char *p;
 
+          STATS_COUNT (stats);
           EINTRLOOP (e, lstat (lpath, &st));
           if (e)
             {
@@ -1755,3 +2290,38 @@ library_search (const char *lib, FILE_TIMESTAMP *mtime_ptr)
   free (libpatterns);
   return file;
 }
+
+/* Return the name of STATUS, as written in events.  */
+
+static const char *
+update_status_name (enum update_status status)
+{
+  switch (status)
+    {
+    case us_success:
+      return "success";
+    case us_none:
+      return "none";
+    case us_question:
+      return "question";
+    case us_failed:
+      return "failed";
+    }
+  return "unknown";
+}
+
+/* Write an event saying whether an implicit rule was FOUND for FILE.  */
+
+static void
+implicit_rule_event (struct file *file, int found)
+{
+  if (!EVENTS_ENABLED)
+    return;
+
+  event_begin ("implicit-rule");
+  event_str ("target", file->name);
+  event_bool ("found", found);
+  if (found && file->stem)
+    event_str ("stem", file->stem);
+  event_end ();
+}
@@ -29,7 +29,7 @@ this program.  If not, see <http://www.gnu.org/licenses/>.  */
 
 #include "customs.h"
 
-char *remote_description = "Customs";
+const char *remote_description = "Customs";
 
 /* File name of the Customs 'export' client command.
    A full path name can be used to avoid some path-searching overhead.  */
@@ -128,14 +128,16 @@ start_remote_job_p (int first_p)
 }
 
 /* Start a remote job running the command in ARGV, with environment from
-   ENVP.  It gets standard input from STDIN_FD.  On failure, return
-   nonzero.  On success, return zero, and set *USED_STDIN to nonzero if it
-   will actually use STDIN_FD, zero if not, set *ID_PTR to a unique
-   identification, and set *IS_REMOTE to nonzero if the job is remote, zero
-   if it is local (meaning *ID_PTR is a process ID).  */
+   ENVP.  It gets standard input from STDIN_FD and writes its output to
+   STDOUT_FD and STDERR_FD.  On failure, return nonzero.  On success,
+   return zero, and set *USED_STDIN to nonzero if it will actually use
+   STDIN_FD, zero if not, set *ID_PTR to a unique identification, and set
+   *IS_REMOTE to nonzero if the job is remote, zero if it is local (meaning
+   *ID_PTR is a process ID).  */
 
 int
 start_remote_job (char **argv, char **envp, int stdin_fd,
+                  int stdout_fd, int stderr_fd,
                   int *is_remote, pid_t *id_ptr, int *used_stdin)
 {
   char waybill[MAX_DATA_SIZE], msg[128];
@@ -245,6 +247,12 @@ start_remote_job (char **argv, char **envp, int stdin_fd,
       if (stdin_fd != 0)
         (void) dup2 (stdin_fd, 0);
 
+      /* Send the output where the job's output should go.  */
+      if (stdout_fd != 1)
+        (void) dup2 (stdout_fd, 1);
+      if (stderr_fd != 2)
+        (void) dup2 (stderr_fd, 2);
+
       /* Unblock signals in the child.  */
       unblock_all_sigs ();
 
@@ -274,6 +282,16 @@ remote_status (int *exit_code_ptr, int *signal_ptr, int *coredump_ptr,
   return -1;
 }
 
+/* Store in FDS, which has room for MAX entries, the file descriptors that
+   become readable when a remote child may have finished.  Return how many
+   there are.  */
+
+unsigned int
+remote_status_fds (int *fds UNUSED, unsigned int max UNUSED)
+{
+  return 0;
+}
+
 /* Block asynchronous notification of remote child death.
    If this notification is done by raising the child termination
    signal, do not block that signal.  */
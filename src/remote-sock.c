@@ -0,0 +1,584 @@
+/* GNU Make remote job exportation interface to executor daemons.
+Copyright (C) 2020 Free Software Foundation, Inc.
+This file is part of GNU Make.
+
+GNU Make is free software; you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation; either version 3 of the License, or (at your option) any later
+version.
+
+GNU Make is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/* Jobs are sent to the executor daemons listed in the MAKE_REMOTE_EXECUTORS
+   environment variable, separated by whitespace.  An entry containing a
+   slash is the name of a Unix domain socket (a "unix:" prefix is allowed);
+   any other entry is HOST:PORT for a TCP socket.  Executors are used in
+   turn; if none of them accepts a job, it is run locally.
+
+   Each job uses one connection.  Both directions are a sequence of frames:
+   one type byte, a four byte big-endian payload length, and the payload.
+   make sends:
+     'C'  the directory to run the job in
+     'A'  one argument of the command, in order
+     'E'  one environment variable, as NAME=VALUE
+     'R'  (empty) run the job
+   and the executor answers with any number of:
+     '1'  data the job wrote to its standard output
+     '2'  data the job wrote to its standard error
+   followed by one final frame:
+     'S'  the exit status, as the decimal exit code and signal number
+          separated by a space
+     'F'  a message saying why the job could not be run
+   If make closes the connection early the executor should kill the job.
+
+   The job's standard input is not forwarded.  make reads the output and
+   status itself whenever it waits for children, and sleeps on the
+   connections together with its local children and the jobserver, so
+   hundreds of jobs can be in flight without extra processes or polling.
+   tests/executor.pl implements an executor for testing.
+
+   Connecting to an executor and sending it the job are done synchronously,
+   so make does nothing else while an executor is slow to accept a job.
+   The job is small and an executor that is up answers at once; one that is
+   down usually refuses the connection at once too, and the next executor
+   is tried.  */
+
+#include "makeint.h"
+#include "filedef.h"
+#include "job.h"
+#include "commands.h"
+#include "debug.h"
+#include "os.h"
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netdb.h>
+#include <poll.h>
+
+/* Don't die of SIGPIPE if an executor goes away while we send a job.  */
+#ifndef MSG_NOSIGNAL
+# define MSG_NOSIGNAL 0
+#endif
+
+const char *remote_description = "sockets";
+
+/* The executors to send jobs to.  */
+static const char **executors = 0;
+static unsigned int executor_count = 0;
+
+/* The executor to try first for the next job.  */
+static unsigned int next_executor = 0;
+
+/* A job sent to an executor.  */
+struct remote_job
+  {
+    struct remote_job *next;
+    pid_t id;                   /* Our identification for the job.  */
+    int fd;                     /* Connection to the executor.  */
+    int out, err;               /* Where the job's output goes.  */
+    char *buf;                  /* Data received but not handled yet.  */
+    size_t buflen, bufsize;
+    int done;                   /* Nonzero once the status is known.  */
+    int exit_code, signal;
+  };
+
+/* The jobs that have not been reaped yet.  */
+static struct remote_job *jobs = 0;
+
+/* Parse MAKE_REMOTE_EXECUTORS.  Call once at startup even if no commands
+   are run.  */
+
+void
+remote_setup (void)
+{
+  const char *list = getenv ("MAKE_REMOTE_EXECUTORS");
+  const char *p;
+  size_t len;
+
+  if (list == 0)
+    return;
+
+  while ((p = find_next_token (&list, &len)) != 0)
+    {
+      executors = xrealloc (executors,
+                            (executor_count + 1) * sizeof (const char *));
+      executors[executor_count++] = xstrndup (p, len);
+    }
+}
+
+/* Called before exit.  */
+
+void
+remote_cleanup (void)
+{
+}
+
+/* Return nonzero if the next job should be done remotely.  */
+
+int
+start_remote_job_p (int first_p UNUSED)
+{
+  return executor_count > 0;
+}
+
+/* Open a connection to the executor at ADDRESS.  Return the socket, or -1
+   and set errno on failure.  */
+
+static int
+connect_executor (const char *address)
+{
+  const char *colon;
+  int fd, r;
+
+  if (strncmp (address, "unix:", 5) == 0)
+    address += 5;
+
+  colon = strrchr (address, ':');
+  if (strchr (address, '/') != 0 || colon == 0)
+    {
+      struct sockaddr_un sun;
+
+      if (strlen (address) >= sizeof (sun.sun_path))
+        {
+          errno = ENAMETOOLONG;
+          return -1;
+        }
+
+      memset (&sun, '\0', sizeof (sun));
+      sun.sun_family = AF_UNIX;
+      strcpy (sun.sun_path, address);
+
+      EINTRLOOP (fd, socket (AF_UNIX, SOCK_STREAM, 0));
+      if (fd < 0)
+        return -1;
+      EINTRLOOP (r, connect (fd, (struct sockaddr *) &sun, sizeof (sun)));
+    }
+  else
+    {
+      struct addrinfo hints, *res, *ai;
+      char *host = xstrndup (address, colon - address);
+
+      memset (&hints, '\0', sizeof (hints));
+      hints.ai_family = AF_UNSPEC;
+      hints.ai_socktype = SOCK_STREAM;
+      r = getaddrinfo (host, colon + 1, &hints, &res);
+      free (host);
+      if (r != 0)
+        {
+          errno = ECONNREFUSED;
+          return -1;
+        }
+
+      fd = -1;
+      for (ai = res; ai != 0; ai = ai->ai_next)
+        {
+          EINTRLOOP (fd, socket (ai->ai_family, ai->ai_socktype,
+                                 ai->ai_protocol));
+          if (fd < 0)
+            continue;
+          EINTRLOOP (r, connect (fd, ai->ai_addr, ai->ai_addrlen));
+          if (r == 0)
+            break;
+          close (fd);
+          fd = -1;
+        }
+      freeaddrinfo (res);
+      if (fd < 0)
+        return -1;
+      r = 0;
+    }
+
+  if (r < 0)
+    {
+      int e = errno;
+      close (fd);
+      errno = e;
+      return -1;
+    }
+
+  fd_noinherit (fd);
+  return fd;
+}
+
+/* Write all LEN bytes at BUF to FD.  Return 0 on success, -1 on error.  */
+
+static int
+write_all (int fd, const char *buf, size_t len)
+{
+  while (len > 0)
+    {
+      ssize_t n;
+      EINTRLOOP (n, write (fd, buf, len));
+      if (n <= 0)
+        return -1;
+      buf += n;
+      len -= n;
+    }
+  return 0;
+}
+
+/* Send all LEN bytes at BUF to the socket FD.  */
+
+static int
+send_all (int fd, const char *buf, size_t len)
+{
+  while (len > 0)
+    {
+      ssize_t n;
+      EINTRLOOP (n, send (fd, buf, len, MSG_NOSIGNAL));
+      if (n <= 0)
+        return -1;
+      buf += n;
+      len -= n;
+    }
+  return 0;
+}
+
+/* Send a frame of TYPE with LEN bytes of DATA.  */
+
+static int
+send_frame (int fd, char type, const char *data, size_t len)
+{
+  unsigned char hdr[5];
+
+  hdr[0] = type;
+  hdr[1] = (len >> 24) & 0xff;
+  hdr[2] = (len >> 16) & 0xff;
+  hdr[3] = (len >> 8) & 0xff;
+  hdr[4] = len & 0xff;
+
+  if (send_all (fd, (char *) hdr, sizeof (hdr)) < 0)
+    return -1;
+  return send_all (fd, data, len);
+}
+
+/* Send the job in ARGV, with environment ENVP, to the executor on FD.  */
+
+static int
+send_job (int fd, char **argv, char **envp)
+{
+  char *cwd = starting_directory;
+
+  if (send_frame (fd, 'C', cwd, strlen (cwd)) < 0)
+    return -1;
+  for (; *argv != 0; ++argv)
+    if (send_frame (fd, 'A', *argv, strlen (*argv)) < 0)
+      return -1;
+  for (; *envp != 0; ++envp)
+    if (send_frame (fd, 'E', *envp, strlen (*envp)) < 0)
+      return -1;
+  return send_frame (fd, 'R', "", 0);
+}
+
+/* Append the data waiting on JOB's connection to its buffer.  Return 0 if
+   the connection is still open, -1 if it was closed or failed.  */
+
+static int
+fill_buffer (struct remote_job *job)
+{
+  ssize_t n;
+
+  if (job->buflen + 4096 > job->bufsize)
+    {
+      job->bufsize = job->buflen + 8192;
+      job->buf = xrealloc (job->buf, job->bufsize);
+    }
+
+  EINTRLOOP (n, read (job->fd, job->buf + job->buflen,
+                      job->bufsize - job->buflen));
+  if (n < 0 && errno == EAGAIN)
+    return 0;
+  if (n <= 0)
+    return -1;
+
+  job->buflen += n;
+  return 0;
+}
+
+/* Handle the complete frames in JOB's buffer: copy output to where it
+   belongs and note the final status.  */
+
+static void
+handle_frames (struct remote_job *job)
+{
+  unsigned char *p = (unsigned char *) job->buf;
+  size_t left = job->buflen;
+
+  while (!job->done && left >= 5)
+    {
+      size_t len = ((size_t)p[1] << 24) | (p[2] << 16) | (p[3] << 8) | p[4];
+      char *data = (char *) p + 5;
+
+      if (left < 5 + len)
+        break;
+
+      switch (p[0])
+        {
+        case '1':
+          write_all (job->out, data, len);
+          break;
+        case '2':
+          write_all (job->err, data, len);
+          break;
+        case 'S':
+          {
+            char status[64];
+            if (len >= sizeof (status))
+              len = sizeof (status) - 1;
+            memcpy (status, data, len);
+            status[len] = '\0';
+            sscanf (status, "%d %d", &job->exit_code, &job->signal);
+            job->done = 1;
+          }
+          break;
+        case 'F':
+          write_all (job->err, data, len);
+          write_all (job->err, "\n", 1);
+          job->exit_code = 127;
+          job->done = 1;
+          break;
+        default:
+          break;
+        }
+
+      p += 5 + len;
+      left -= 5 + len;
+    }
+
+  memmove (job->buf, p, left);
+  job->buflen = left;
+}
+
+/* Read what is available from every remote job, waiting up to TIMEOUT
+   milliseconds (forever if it is negative) for something to arrive.
+   poll() has no limit on the descriptor numbers, which may be large when
+   many jobs are in flight.  */
+
+static void
+poll_jobs (int timeout)
+{
+  static struct pollfd *pfds = 0;
+  static unsigned int pfds_max = 0;
+  struct remote_job *job;
+  unsigned int n = 0, i;
+  int r;
+
+  for (job = jobs; job != 0; job = job->next)
+    if (!job->done)
+      {
+        if (n == pfds_max)
+          {
+            pfds_max = pfds_max ? pfds_max * 2 : 64;
+            pfds = xrealloc (pfds, pfds_max * sizeof (struct pollfd));
+          }
+        pfds[n].fd = job->fd;
+        pfds[n].events = POLLIN;
+        pfds[n].revents = 0;
+        ++n;
+      }
+
+  if (n == 0)
+    return;
+
+  r = poll (pfds, n, timeout);
+  if (r <= 0)
+    return;
+
+  /* The jobs not done are in the same order as their entries.  */
+  i = 0;
+  for (job = jobs; job != 0; job = job->next)
+    if (!job->done && pfds[i++].revents != 0)
+      {
+        if (fill_buffer (job) < 0)
+          {
+            /* The executor went away without telling us how the job
+               ended.  */
+            static const char msg[] = "lost connection to remote executor\n";
+            handle_frames (job);
+            if (!job->done)
+              {
+                write_all (job->err, msg, sizeof (msg) - 1);
+                job->exit_code = 127;
+                job->done = 1;
+              }
+          }
+        else
+          handle_frames (job);
+      }
+}
+
+/* Start a remote job running the command in ARGV, with environment from
+   ENVP.  It gets standard input from STDIN_FD and writes its output to
+   STDOUT_FD and STDERR_FD.  On failure, return nonzero.  On success,
+   return zero, and set *USED_STDIN to nonzero if it will actually use
+   STDIN_FD, zero if not, set *ID_PTR to a unique identification, and set
+   *IS_REMOTE to nonzero if the job is remote, zero if it is local (meaning
+   *ID_PTR is a process ID).  */
+
+int
+start_remote_job (char **argv, char **envp, int stdin_fd UNUSED,
+                  int stdout_fd, int stderr_fd,
+                  int *is_remote, pid_t *id_ptr, int *used_stdin)
+{
+  static pid_t last_id = 0;
+  struct remote_job *job;
+  unsigned int i;
+  int fd = -1;
+
+  if (starting_directory == 0)
+    return 1;
+
+  /* Try each executor once, starting with the one after the last used.  */
+  for (i = 0; i < executor_count; ++i)
+    {
+      const char *address = executors[(next_executor + i) % executor_count];
+
+      fd = connect_executor (address);
+      if (fd >= 0 && send_job (fd, argv, envp) == 0)
+        {
+          DB (DB_JOBS, (_("Sent job to executor %s\n"), address));
+          next_executor = (next_executor + i + 1) % executor_count;
+          break;
+        }
+
+      DB (DB_JOBS, (_("Executor %s is unavailable: %s\n"),
+                    address, strerror (errno)));
+      if (fd >= 0)
+        close (fd);
+      fd = -1;
+    }
+
+  if (fd < 0)
+    return 1;
+
+  /* From now on we only read what is available.  */
+  {
+    int flags, r;
+    EINTRLOOP (flags, fcntl (fd, F_GETFL));
+    if (flags >= 0)
+      EINTRLOOP (r, fcntl (fd, F_SETFL, flags | O_NONBLOCK));
+  }
+
+  job = xcalloc (sizeof (struct remote_job));
+  job->id = ++last_id;
+  job->fd = fd;
+  job->out = stdout_fd;
+  job->err = stderr_fd;
+  job->next = jobs;
+  jobs = job;
+
+  *is_remote = 1;
+  *id_ptr = job->id;
+  *used_stdin = 0;
+  return 0;
+}
+
+/* Get the status of a dead remote child.  Block waiting for one to die
+   if BLOCK is nonzero.  Set *EXIT_CODE_PTR to the exit status, *SIGNAL_PTR
+   to the termination signal or zero if it exited normally, and *COREDUMP_PTR
+   nonzero if it dumped core.  Return the ID of the child that died,
+   0 if we would have to block and !BLOCK, or < 0 if there were none.  */
+
+int
+remote_status (int *exit_code_ptr, int *signal_ptr, int *coredump_ptr,
+               int block)
+{
+  struct remote_job *job, *last;
+
+  if (jobs == 0)
+    {
+      errno = ECHILD;
+      return -1;
+    }
+
+  poll_jobs (0);
+
+  while (1)
+    {
+      for (last = 0, job = jobs; job != 0; last = job, job = job->next)
+        if (job->done)
+          {
+            pid_t id = job->id;
+
+            if (last)
+              last->next = job->next;
+            else
+              jobs = job->next;
+
+            *exit_code_ptr = job->exit_code;
+            *signal_ptr = job->signal;
+            *coredump_ptr = 0;
+
+            close (job->fd);
+            free (job->buf);
+            free (job);
+            return id;
+          }
+
+      if (!block)
+        return 0;
+
+      poll_jobs (-1);
+    }
+}
+
+/* Store in FDS, which has room for MAX entries, the file descriptors that
+   become readable when a remote child may have finished.  Return how many
+   there are; the caller can then sleep on them together with its local
+   children and the jobserver.  */
+
+unsigned int
+remote_status_fds (int *fds, unsigned int max)
+{
+  struct remote_job *job;
+  unsigned int n = 0;
+
+  for (job = jobs; job != 0 && n < max; job = job->next)
+    fds[n++] = job->fd;
+
+  return n;
+}
+
+/* Block asynchronous notification of remote child death.
+   If this notification is done by raising the child termination
+   signal, do not block that signal.  */
+void
+block_remote_children (void)
+{
+  return;
+}
+
+/* Restore asynchronous notification of remote child death.
+   If this is done by raising the child termination signal,
+   do not unblock that signal.  */
+void
+unblock_remote_children (void)
+{
+  return;
+}
+
+/* Send signal SIG to child ID.  Return 0 if successful, -1 if not.
+   Closing the connection tells the executor to kill the job; the job is
+   then reported as killed by SIG.  */
+int
+remote_kill (pid_t id, int sig)
+{
+  struct remote_job *job;
+
+  for (job = jobs; job != 0; job = job->next)
+    if (job->id == id && !job->done)
+      {
+        shutdown (job->fd, SHUT_RDWR);
+        job->signal = sig;
+        job->done = 1;
+        return 0;
+      }
+
+  return -1;
+}
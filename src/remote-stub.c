@@ -20,7 +20,7 @@ this program.  If not, see <http://www.gnu.org/licenses/>.  */
 #include "commands.h"
 
 
-char *remote_description = 0;
+const char *remote_description = 0;
 
 /* Call once at startup even if no commands are run.  */
 
@@ -45,14 +45,16 @@ start_remote_job_p (int first_p UNUSED)
 }
 
 /* Start a remote job running the command in ARGV,
-   with environment from ENVP.  It gets standard input from STDIN_FD.  On
-   failure, return nonzero.  On success, return zero, and set *USED_STDIN
-   to nonzero if it will actually use STDIN_FD, zero if not, set *ID_PTR to
-   a unique identification, and set *IS_REMOTE to zero if the job is local,
-   nonzero if it is remote (meaning *ID_PTR is a process ID).  */
+   with environment from ENVP.  It gets standard input from STDIN_FD and
+   writes its output to STDOUT_FD and STDERR_FD.  On failure, return
+   nonzero.  On success, return zero, and set *USED_STDIN to nonzero if it
+   will actually use STDIN_FD, zero if not, set *ID_PTR to a unique
+   identification, and set *IS_REMOTE to zero if the job is local, nonzero
+   if it is remote (meaning *ID_PTR is a process ID).  */
 
 int
 start_remote_job (char **argv UNUSED, char **envp UNUSED, int stdin_fd UNUSED,
+                  int stdout_fd UNUSED, int stderr_fd UNUSED,
                   int *is_remote UNUSED, pid_t *id_ptr UNUSED,
                   int *used_stdin UNUSED)
 {
@@ -73,6 +75,16 @@ remote_status (int *exit_code_ptr UNUSED, int *signal_ptr UNUSED,
   return -1;
 }
 
+/* Store in FDS, which has room for MAX entries, the file descriptors that
+   become readable when a remote child may have finished.  Return how many
+   there are.  */
+
+unsigned int
+remote_status_fds (int *fds UNUSED, unsigned int max UNUSED)
+{
+  return 0;
+}
+
 /* Block asynchronous notification of remote child death.
    If this notification is done by raising the child termination
    signal, do not block that signal.  */
@@ -24,6 +24,7 @@ this program.  If not, see <http://www.gnu.org/licenses/>.  */
 #include "commands.h"
 #include "variable.h"
 #include "rule.h"
+#include "dump.h"
 
 static void freerule (struct rule *rule, struct rule *lastrule);
 
@@ -558,3 +559,37 @@ print_rule_data_base (void)
              num_pattern_rules, rules);
     }
 }
+
+/* Write the data base of rules for --print-data-base=json.  */
+
+void
+dump_rule_data_base (void)
+{
+  struct rule *r;
+
+  dump_begin_array ("rules");
+
+  for (r = pattern_rules; r != 0; r = r->next)
+    {
+      unsigned int i;
+
+      dump_begin_object (0);
+
+      dump_begin_array ("targets");
+      for (i = 0; i < r->num; ++i)
+        dump_str (0, r->targets[i]);
+      dump_end_array ();
+
+      if (r->terminal)
+        dump_bool ("terminal", 1);
+
+      dump_prereqs (r->deps);
+
+      if (r->cmds != 0)
+        dump_commands (r->cmds);
+
+      dump_end_object ();
+    }
+
+  dump_end_array ();
+}
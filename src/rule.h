@@ -55,3 +55,4 @@ void create_pattern_rule (const char **targets, const char **target_percents,
                           unsigned short num, int terminal, struct dep *deps,
                           struct commands *commands, int override);
 void print_rule_data_base (void);
+void dump_rule_data_base (void);
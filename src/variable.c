@@ -28,6 +28,7 @@ this program.  If not, see <http://www.gnu.org/licenses/>.  */
 #include "pathstuff.h"
 #endif
 #include "hash.h"
+#include "dump.h"
 
 /* Incremented every time we add or remove a global variable.  */
 static unsigned long variable_changenum;
@@ -176,6 +177,49 @@ static struct variable_set_list global_setlist
   = { 0, &global_variable_set, 0 };
 struct variable_set_list *current_variable_set_list = &global_setlist;
 
+/* Variables from the process environment.  They are only defined as make
+   variables when they are first looked up, or when all the variables are
+   needed, so that a large environment costs little when most of it is just
+   passed on to the commands.  */
+
+struct env_var
+  {
+    const char *def;            /* "NAME=VALUE" in the environment.  */
+    unsigned int length;        /* Length of NAME.  */
+    unsigned int defined:1;     /* Nonzero once it is a make variable.  */
+  };
+
+static struct hash_table env_vars;
+
+/* Number of the env_vars which are not defined yet.  */
+
+static unsigned int env_vars_pending = 0;
+
+static unsigned long
+env_var_hash_1 (const void *keyv)
+{
+  struct env_var const *key = (struct env_var const *) keyv;
+  return_STRING_N_HASH_1 (key->def, key->length);
+}
+
+static unsigned long
+env_var_hash_2 (const void *keyv)
+{
+  struct env_var const *key = (struct env_var const *) keyv;
+  return_STRING_N_HASH_2 (key->def, key->length);
+}
+
+static int
+env_var_hash_cmp (const void *xv, const void *yv)
+{
+  struct env_var const *x = (struct env_var const *) xv;
+  struct env_var const *y = (struct env_var const *) yv;
+  int result = x->length - y->length;
+  if (result)
+    return result;
+  return_STRING_N_COMPARE (x->def, y->def, x->length);
+}
+
 /* Implement variables.  */
 
 void
@@ -183,6 +227,90 @@ init_hash_global_variable_set (void)
 {
   hash_init (&global_variable_set.table, VARIABLE_BUCKETS,
              variable_hash_1, variable_hash_2, variable_hash_cmp);
+  hash_init (&env_vars, VARIABLE_BUCKETS,
+             env_var_hash_1, env_var_hash_2, env_var_hash_cmp);
+}
+
+/* Remember the environment entry DEF, whose name is LENGTH chars long, to be
+   defined as an exported variable when it is needed.  DEF is not copied.  A
+   later entry for the same name replaces an earlier one.  */
+
+void
+define_env_variable_lazily (const char *def, size_t length)
+{
+  struct env_var **slot;
+  struct env_var key;
+
+  key.def = def;
+  key.length = (unsigned int) length;
+  slot = (struct env_var **) hash_find_slot (&env_vars, &key);
+
+  if (HASH_VACANT (*slot))
+    {
+      struct env_var *e = xmalloc (sizeof (struct env_var));
+      e->def = def;
+      e->length = (unsigned int) length;
+      e->defined = 0;
+      hash_insert_at (&env_vars, e, slot);
+      ++env_vars_pending;
+    }
+  else
+    (*slot)->def = def;
+}
+
+/* Define the make variable for E, a pending environment variable.  */
+
+static struct variable *
+define_pending_env_var (struct env_var *e)
+{
+  struct variable *v;
+
+  /* Mark it first: defining it comes back here through
+     define_variable_in_set.  */
+  e->defined = 1;
+  --env_vars_pending;
+
+  v = define_variable_in_set (e->def, e->length, e->def + e->length + 1,
+                              o_env, 1, NULL, NILF);
+
+  /* As if it had been defined before -e was seen.  */
+  v->origin = o_env;
+  v->export = v_export;
+  return v;
+}
+
+/* If NAME is a pending environment variable, define it and return it.  */
+
+static struct variable *
+define_env_variable (const char *name, size_t length)
+{
+  struct env_var *e;
+  struct env_var key;
+
+  key.def = name;
+  key.length = (unsigned int) length;
+  e = hash_find_item (&env_vars, &key);
+
+  return e && !e->defined ? define_pending_env_var (e) : 0;
+}
+
+/* Define all the pending environment variables, for those who need to see
+   every variable.  */
+
+void
+define_env_variables (void)
+{
+  struct env_var **ep;
+  struct env_var **end;
+
+  if (!env_vars_pending)
+    return;
+
+  ep = (struct env_var **) env_vars.ht_vec;
+  end = ep + env_vars.ht_size;
+  for (; ep < end; ++ep)
+    if (!HASH_VACANT (*ep) && !(*ep)->defined)
+      define_pending_env_var (*ep);
 }
 
 /* Define variable named NAME with value VALUE in SET.  VALUE is copied.
@@ -205,6 +333,10 @@ define_variable_in_set (const char *name, size_t length,
   if (set == NULL)
     set = &global_variable_set;
 
+  /* Any environment variable of this name is an existing definition.  */
+  if (env_vars_pending && set == &global_variable_set)
+    define_env_variable (name, length);
+
   var_key.name = (char *) name;
   var_key.length = (unsigned int) length;
   var_slot = (struct variable **) hash_find_slot (&set->table, &var_key);
@@ -335,6 +467,9 @@ undefine_variable_in_set (const char *name, size_t length,
   if (set == NULL)
     set = &global_variable_set;
 
+  if (env_vars_pending && set == &global_variable_set)
+    define_env_variable (name, length);
+
   var_key.name = (char *) name;
   var_key.length = (unsigned int) length;
   var_slot = (struct variable **) hash_find_slot (&set->table, &var_key);
@@ -404,6 +539,9 @@ lookup_special_var (struct variable *var)
   else
   */
 
+  if (env_vars_pending && streq (var->name, ".VARIABLES"))
+    define_env_variables ();
+
   if (variable_changenum != last_changenum && streq (var->name, ".VARIABLES"))
     {
       size_t max = EXPANSION_INCREMENT (strlen (var->value));
@@ -476,6 +614,14 @@ lookup_variable (const char *name, size_t length)
       is_parent |= setlist->next_is_parent;
     }
 
+  /* It may be in the environment, but not defined yet.  */
+  if (env_vars_pending)
+    {
+      struct variable *v = define_env_variable (name, length);
+      if (v)
+        return v;
+    }
+
 #ifdef VMS
   /* VMS doesn't populate envp[] with DCL symbols and logical names, which
      historically are mapped to environment variables and returned by
@@ -546,11 +692,16 @@ lookup_variable_in_set (const char *name, size_t length,
                         const struct variable_set *set)
 {
   struct variable var_key;
+  struct variable *v;
 
   var_key.name = (char *) name;
   var_key.length = (unsigned int) length;
 
-  return (struct variable *) hash_find_item ((struct hash_table *) &set->table, &var_key);
+  v = (struct variable *) hash_find_item ((struct hash_table *) &set->table, &var_key);
+  if (v == 0 && env_vars_pending && set == &global_variable_set)
+    v = define_env_variable (name, length);
+
+  return v;
 }
 
 /* Initialize FILE's variable set list.  If FILE already has a variable set
@@ -1077,7 +1228,36 @@ target_environment (struct file *file)
   makelevel_key.length = MAKELEVEL_LENGTH;
   hash_delete (&table, &makelevel_key);
 
-  result = result_0 = xmalloc ((table.ht_fill + 3) * sizeof (char *));
+  result = result_0 = xmalloc ((table.ht_fill + env_vars_pending + 3)
+                               * sizeof (char *));
+
+  /* Pass the environment variables which were never defined on unchanged,
+     without copying them, unless a target-specific variable hides them.  */
+  if (env_vars_pending)
+    {
+      struct env_var **ep = (struct env_var **) env_vars.ht_vec;
+      struct env_var **end = ep + env_vars.ht_size;
+
+      for (; ep < end; ++ep)
+        if (!HASH_VACANT (*ep) && !(*ep)->defined)
+          {
+            struct env_var *e = *ep;
+            struct variable key;
+            struct variable *v;
+
+            key.name = (char *) e->def;
+            key.length = e->length;
+            if (e->length == MAKELEVEL_LENGTH
+                && strneq (e->def, MAKELEVEL_NAME, MAKELEVEL_LENGTH))
+              continue;
+
+            v = hash_find_item (&table, &key);
+            if (v == 0)
+              *result++ = (char *) e->def;
+            else if (v->export == v_default)
+              v->export = v_export;
+          }
+    }
 
   v_slot = (struct variable **) table.ht_vec;
   v_end = v_slot + table.ht_size;
@@ -1132,6 +1312,29 @@ target_environment (struct file *file)
 
   return result_0;
 }
+
+/* Free ENV, an environment made by target_environment.  The entries passed
+   on from the process environment are not ours to free.  */
+
+void
+free_target_environment (char **env)
+{
+  char **ep;
+
+  for (ep = env; *ep != 0; ++ep)
+    {
+      struct env_var key;
+      struct env_var *e;
+
+      key.def = *ep;
+      key.length = (unsigned int) (strchr (*ep, '=') - *ep);
+      e = hash_find_item (&env_vars, &key);
+      if (e == 0 || e->def != *ep)
+        free (*ep);
+    }
+
+  free (env);
+}
 
 static struct variable *
 set_special_var (struct variable *var)
@@ -1768,6 +1971,7 @@ print_variable_data_base (void)
 {
   puts (_("\n# Variables\n"));
 
+  define_env_variables ();
   print_variable_set (&global_variable_set, "", 0);
 
   puts (_("\n# Pattern-specific Variable Values"));
@@ -1790,6 +1994,16 @@ print_variable_data_base (void)
   }
 }
 
+/* Print the statistics of the global variables hash table, for --stats.  */
+
+void
+print_variable_stats (void)
+{
+  fputs (_("# variables hash-table: "), stdout);
+  hash_print_stats (&global_variable_set.table, stdout);
+  putc ('\n', stdout);
+}
+
 
 /* Print all the local variables of FILE.  */
 
@@ -1817,6 +2031,92 @@ print_target_variables (const struct file *file)
     }
 }
 
+/* Write the variable V for --print-data-base=json.  If PATTERN is not
+   null, V is a pattern-specific value for it.  */
+
+static void
+dump_variable (const struct variable *v, const char *pattern)
+{
+  static const char *const origins[] =
+    {
+      "default", "environment", "makefile", "environment override",
+      "command line", "override", "automatic"
+    };
+
+  assert (v->origin < o_invalid);
+
+  dump_begin_object (0);
+  if (pattern)
+    dump_str ("pattern", pattern);
+  dump_str ("name", v->name);
+  dump_str ("value", v->value);
+  dump_str ("flavor", v->recursive ? "recursive" : "simple");
+  dump_str ("origin", origins[v->origin]);
+  if (v->append)
+    dump_bool ("append", 1);
+  if (v->conditional)
+    dump_bool ("conditional", 1);
+  if (v->private_var)
+    dump_bool ("private", 1);
+  if (v->export == v_export)
+    dump_bool ("export", 1);
+  else if (v->export == v_noexport)
+    dump_bool ("export", 0);
+  if (v->fileinfo.filenm)
+    {
+      dump_str ("file", v->fileinfo.filenm);
+      dump_uint ("line", v->fileinfo.lineno + v->fileinfo.offset);
+    }
+  dump_end_object ();
+}
+
+static void
+dump_noauto_variable (const void *item)
+{
+  const struct variable *v = item;
+
+  if (v->origin != o_automatic)
+    dump_variable (v, 0);
+}
+
+static int
+dump_variable_compare (const void *x, const void *y)
+{
+  return strcmp ((*(const struct variable **) x)->name,
+                 (*(const struct variable **) y)->name);
+}
+
+/* Write the data base of variables for --print-data-base=json.  */
+
+void
+dump_variable_data_base (void)
+{
+  struct pattern_var *p;
+
+  define_env_variables ();
+
+  dump_begin_array ("variables");
+  dump_table (&global_variable_set.table, dump_noauto_variable,
+              dump_variable_compare);
+  dump_end_array ();
+
+  dump_begin_array ("pattern_variables");
+  for (p = pattern_vars; p != 0; p = p->next)
+    dump_variable (&p->variable, p->target);
+  dump_end_array ();
+}
+
+/* Write the target-specific variables of FILE.  */
+
+void
+dump_target_variables (const struct file *file)
+{
+  dump_begin_array ("variables");
+  dump_table (&file->variables->set->table, dump_noauto_variable,
+              dump_variable_compare);
+  dump_end_array ();
+}
+
 #ifdef WINDOWS32
 void
 sync_Path_environment (void)
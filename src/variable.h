@@ -111,6 +111,14 @@ struct pattern_var
     struct variable variable;
   };
 
+/* The result of a function registered by gmk_add_output_function(): the
+   end of the output so far, in the variable buffer.  */
+
+struct gmk_output
+  {
+    char *o;
+  };
+
 extern char *variable_buffer;
 extern struct variable_set_list *current_variable_set_list;
 extern struct variable *default_goal_var;
@@ -129,6 +137,7 @@ char *allocated_variable_expand_for_file (const char *line, struct file *file);
   allocated_variable_expand_for_file (line, (struct file *) 0)
 char *expand_argument (const char *str, const char *end);
 char *variable_expand_string (char *line, const char *string, size_t length);
+char *variable_expand_output (char *o, const char *string, size_t length);
 char *initialize_variable_output ();
 void install_variable_buffer (char **bufp, size_t *lenp);
 void restore_variable_buffer (char *buf, size_t len);
@@ -149,6 +158,9 @@ void shell_completed (int exit_code, int exit_sig);
 /* expand.c */
 char *recursively_expand_for_file (struct variable *v, struct file *file);
 #define recursively_expand(v)   recursively_expand_for_file (v, NULL)
+void expand_profile_enter (const char *name, char kind);
+void expand_profile_leave (size_t bytes);
+void print_expand_profile (const char *dumpfile);
 
 /* variable.c */
 struct variable_set_list *create_new_variable_set (void);
@@ -159,6 +171,7 @@ void define_automatic_variables (void);
 void initialize_file_variables (struct file *file, int reading);
 void print_file_variables (const struct file *file);
 void print_target_variables (const struct file *file);
+void dump_target_variables (const struct file *file);
 void merge_variable_set_lists (struct variable_set_list **to_list,
                                struct variable_set_list *from_list);
 struct variable *do_variable_definition (const floc *flocp,
@@ -177,6 +190,9 @@ void hash_init_function_table (void);
 void define_new_function(const floc *flocp, const char *name,
                          unsigned int min, unsigned int max, unsigned int flags,
                          gmk_func_ptr func);
+void define_new_output_function (const floc *flocp, const char *name,
+                                 unsigned int min, unsigned int max,
+                                 unsigned int flags, gmk_output_func_ptr func);
 struct variable *lookup_variable (const char *name, size_t length);
 struct variable *lookup_variable_in_set (const char *name, size_t length,
                                          const struct variable_set *set);
@@ -235,6 +251,9 @@ void undefine_variable_in_set (const char *name, size_t length,
                               }while(0)
 
 char **target_environment (struct file *file);
+void free_target_environment (char **env);
+void define_env_variable_lazily (const char *def, size_t length);
+void define_env_variables (void);
 
 struct pattern_var *create_pattern_var (const char *target,
                                         const char *suffix);
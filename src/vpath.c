@@ -501,6 +501,7 @@ selective_vpath_search (struct vpath *path, const char *file,
             {
               int e;
 
+              STATS_COUNT (stats);
               EINTRLOOP (e, stat (name, &st)); /* Does it really exist?  */
               if (e != 0)
                 {
@@ -0,0 +1,148 @@
+#!/usr/bin/env perl
+# -*-perl-*-
+#
+# A remote executor for testing make's socket remote job backend
+# (src/remote-sock.c, which describes the protocol).  It runs each job
+# locally, in its own process, and sends back its output and exit status.
+#
+# Usage: executor.pl [-p <pidfile>] <address>
+#
+# ADDRESS is the name of a Unix domain socket (optionally prefixed with
+# "unix:") or HOST:PORT for a TCP socket.  If -p is given the executor
+# writes its process ID to PIDFILE once it is ready to accept jobs.
+# Each job's output is preceded by a line "[executor]" on its standard
+# output, so tests can tell it was run remotely.
+
+use strict;
+use warnings;
+use Socket;
+use IO::Socket;
+use POSIX qw(:sys_wait_h _exit);
+
+my $pidfile;
+if (@ARGV && $ARGV[0] eq '-p') {
+    shift;
+    $pidfile = shift;
+}
+my $address = shift or die "usage: $0 [-p <pidfile>] <address>\n";
+$address =~ s/^unix://;
+
+my $server;
+if ($address =~ m,/, || $address !~ /:/) {
+    unlink($address);
+    $server = IO::Socket::UNIX->new(Type => SOCK_STREAM, Local => $address,
+                                    Listen => 16)
+        or die "$0: $address: $!\n";
+} else {
+    $server = IO::Socket::INET->new(LocalAddr => $address, Listen => 16,
+                                    ReuseAddr => 1)
+        or die "$0: $address: $!\n";
+}
+
+if ($pidfile) {
+    open(my $fh, '>', "$pidfile.tmp") or die "$0: $pidfile: $!\n";
+    print $fh "$$\n";
+    close($fh);
+    rename("$pidfile.tmp", $pidfile);
+}
+
+$SIG{CHLD} = sub { 1 while waitpid(-1, WNOHANG) > 0; };
+
+sub readn {
+    my ($fh, $n) = @_;
+    my $buf = '';
+    while (length($buf) < $n) {
+        my $r = sysread($fh, $buf, $n - length($buf), length($buf));
+        return undef if !$r;
+    }
+    return $buf;
+}
+
+sub frame {
+    my ($fh, $type, $data) = @_;
+    my $buf = $type . pack('N', length($data)) . $data;
+    while (length($buf)) {
+        my $w = syswrite($fh, $buf);
+        return 0 if !defined($w);
+        substr($buf, 0, $w) = '';
+    }
+    return 1;
+}
+
+sub run_job {
+    my ($conn) = @_;
+    my ($cwd, @argv, %env);
+
+    while (1) {
+        my $hdr = readn($conn, 5);
+        defined $hdr or _exit(1);
+        my ($type, $len) = unpack('a N', $hdr);
+        my $data = $len ? readn($conn, $len) : '';
+        defined $data or _exit(1);
+        if ($type eq 'C') { $cwd = $data; }
+        elsif ($type eq 'A') { push(@argv, $data); }
+        elsif ($type eq 'E') { my ($n, $v) = split(/=/, $data, 2);
+                               $env{$n} = $v; }
+        elsif ($type eq 'R') { last; }
+    }
+
+    if (!@argv || !chdir($cwd)) {
+        frame($conn, 'F', "executor: cannot run job in $cwd");
+        _exit(0);
+    }
+
+    pipe(my $outr, my $outw) or die;
+    pipe(my $errr, my $errw) or die;
+
+    local $SIG{CHLD} = 'DEFAULT';
+    my $pid = fork();
+    if (!$pid) {
+        close($outr); close($errr);
+        open(STDOUT, '>&', $outw); open(STDERR, '>&', $errw);
+        open(STDIN, '<', '/dev/null');
+        %ENV = %env;
+        print "[executor]\n";
+        exec { $argv[0] } @argv
+            or print STDERR "executor: $argv[0]: $!\n";
+        _exit(127);
+    }
+    close($outw); close($errw);
+
+    my %src = (fileno($outr) => [$outr, '1'], fileno($errr) => [$errr, '2']);
+    while (%src) {
+        my $rin = '';
+        vec($rin, $_, 1) = 1 for (keys %src, fileno($conn));
+        select(my $rout = $rin, undef, undef, undef) > 0 or next;
+
+        # Anything readable on the connection means make went away.
+        if (vec($rout, fileno($conn), 1)) {
+            kill('TERM', $pid);
+            _exit(0);
+        }
+
+        for my $fd (keys %src) {
+            vec($rout, $fd, 1) or next;
+            my ($fh, $type) = @{$src{$fd}};
+            my $r = sysread($fh, my $buf, 4096);
+            if ($r) {
+                frame($conn, $type, $buf);
+            } else {
+                delete $src{$fd};
+            }
+        }
+    }
+
+    waitpid($pid, 0);
+    frame($conn, 'S', sprintf('%d %d', $? >> 8, $? & 127));
+    _exit(0);
+}
+
+while (1) {
+    my $conn = $server->accept() or next;
+    my $pid = fork();
+    if (defined($pid) && $pid == 0) {
+        close($server);
+        run_job($conn);
+    }
+    close($conn);
+}
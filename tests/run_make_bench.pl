@@ -0,0 +1,424 @@
+#!/usr/bin/env perl
+# -*-perl-*-
+#
+# Benchmarks for GNU make on synthetic projects.
+#
+# Usage: run_make_bench.pl [-make <make prog>] [-workdir <dir>]
+#                          [-jobs <n>] [-repeat <n>] [-scale <factor>]
+#                          [-output <file>] [-baseline <file>]
+#                          [-tolerance <percent>] [-keep] [scenario...]
+#
+# Each scenario generates a project in WORKDIR/SCENARIO with many targets
+# and trivial recipes, then runs make three ways on it: with -n on a clean
+# tree ("dry"), with -jJOBS on a clean tree ("full") and again once
+# everything is up to date ("noop").  Wall and CPU time are the median of
+# REPEAT runs.  If make supports --stats, its counters (stat, opendir and
+# readdir calls, implicit rule searches, expansions, processes started,
+# peak RSS) are recorded too.
+#
+# The results are written as JSON to OUTPUT (default WORKDIR/bench.json).
+# With -baseline, each result is compared with the one in an earlier
+# output file, and any time or counter more than TOLERANCE percent
+# (default 10) above it is reported as a regression: the exit status is
+# then 1.
+#
+# The scenarios, and the parameters used to generate them, are listed in
+# %scenarios below; without arguments all of them are run.  -scale
+# multiplies the number of targets of each.
+
+# Copyright (C) 2020 Free Software Foundation, Inc.
+# This file is part of GNU Make.
+#
+# GNU Make is free software; you can redistribute it and/or modify it under
+# the terms of the GNU General Public License as published by the Free Software
+# Foundation; either version 3 of the License, or (at your option) any later
+# version.
+#
+# GNU Make is distributed in the hope that it will be useful, but WITHOUT ANY
+# WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+# FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+# details.
+#
+# You should have received a copy of the GNU General Public License along with
+# this program.  If not, see <http://www.gnu.org/licenses/>.
+
+use strict;
+use warnings;
+use Cwd qw(abs_path);
+use File::Path qw(mkpath rmtree);
+use POSIX qw(floor);
+use Time::HiRes qw(time);
+
+# Parameters of a generated project:
+#   targets    number of object files
+#   fanin      headers each object depends on (there are 4 times as many)
+#   depth      pattern rules chained between a source and its object
+#   patterns   extra pattern rules for objects, whose prerequisites never exist
+#   vpath      directories the sources are spread over, found with vpath
+#   dfiles     if set, header dependencies are included from .d files
+#   eval       if set, each object's rule is generated with $(eval ...)
+#   recursive  number of sub-makes the targets are divided between
+
+my %scenarios = (
+    'flat'      => { targets => 2000, fanin => 2 },
+    'deep'      => { targets => 500, depth => 6 },
+    'patterns'  => { targets => 1000, patterns => 200, vpath => 8 },
+    'deps'      => { targets => 2000, fanin => 10, dfiles => 1 },
+    'eval'      => { targets => 2000, fanin => 2, eval => 1 },
+    'recursive' => { targets => 2000, fanin => 2, recursive => 8 },
+);
+
+my @modes = qw(dry full noop);
+
+# Counters printed by --stats, and the names we record them under.
+
+my %stats_keys = (
+    'stat calls'                 => 'stat_calls',
+    'opendir calls'              => 'opendir_calls',
+    'readdir calls'              => 'readdir_calls',
+    'implicit rule searches'     => 'implicit_searches',
+    'variable references'        => 'variable_refs',
+    'function calls'             => 'function_calls',
+    'shell function processes'   => 'shell_processes',
+    'recipe processes'           => 'recipe_processes',
+    'peak resident set size'     => 'rss_kb',
+);
+
+my $make = 'make';
+my $workdir = 'bench-work';
+my $jobs = 4;
+my $repeat = 3;
+my $scale = 1;
+my $output;
+my $baseline;
+my $tolerance = 10;
+my $keep = 0;
+my @run;
+
+sub usage {
+    die "usage: $0 [-make <prog>] [-workdir <dir>] [-jobs <n>] [-repeat <n>]\n"
+      . "       [-scale <factor>] [-output <file>] [-baseline <file>]\n"
+      . "       [-tolerance <percent>] [-keep] [scenario...]\n";
+}
+
+while (@ARGV) {
+    my $arg = shift;
+    if    ($arg eq '-make')      { $make = shift or usage(); }
+    elsif ($arg eq '-workdir')   { $workdir = shift or usage(); }
+    elsif ($arg eq '-jobs')      { $jobs = shift or usage(); }
+    elsif ($arg eq '-repeat')    { $repeat = shift or usage(); }
+    elsif ($arg eq '-scale')     { $scale = shift or usage(); }
+    elsif ($arg eq '-output')    { $output = shift or usage(); }
+    elsif ($arg eq '-baseline')  { $baseline = shift or usage(); }
+    elsif ($arg eq '-tolerance') { $tolerance = shift; defined $tolerance or usage(); }
+    elsif ($arg eq '-keep')      { $keep = 1; }
+    elsif ($arg =~ /^-/)         { usage(); }
+    elsif (!$scenarios{$arg})    { die "$0: unknown scenario '$arg'\n"; }
+    else                         { push(@run, $arg); }
+}
+@run = sort keys %scenarios if !@run;
+
+# Find make on PATH if we weren't given a file name.
+if ($make !~ m,/,) {
+    for my $dir (split(/:/, $ENV{PATH} || '')) {
+        if (-x "$dir/$make") {
+            $make = "$dir/$make";
+            last;
+        }
+    }
+}
+-x $make or die "$0: can't find make program '$make'\n";
+$make = abs_path($make);
+
+mkpath($workdir);
+$workdir = abs_path($workdir);
+$output = "$workdir/bench.json" if !defined $output;
+
+# Don't let the invoking environment change what make does.
+delete @ENV{qw(MAKEFLAGS MFLAGS MAKELEVEL GNUMAKEFLAGS MAKEFILES)};
+
+sub write_file {
+    my ($name, $text) = @_;
+    open(my $fh, '>', $name) or die "$0: $name: $!\n";
+    print $fh $text;
+    close($fh) or die "$0: $name: $!\n";
+}
+
+# Generate the makefile and sources for one (sub-)make building objects
+# FIRST to LAST-1 in directory DIR.
+
+sub generate_unit {
+    my ($dir, $p, $first, $last) = @_;
+    my $headers = ($p->{fanin} || 0) * 4;
+    my $depth = $p->{depth} || 1;
+    my @srcdirs = map { "s$_" } (0 .. ($p->{vpath} || 1) - 1);
+    my $mk = "# Generated by run_make_bench.pl.\n\n";
+
+    mkpath(["$dir/h", "$dir/o", map { "$dir/$_" } @srcdirs]);
+
+    for my $h (0 .. $headers - 1) {
+        write_file("$dir/h/h$h.h", "");
+    }
+
+    my @objs;
+    my %deps;
+    for my $i ($first .. $last - 1) {
+        my $src = $srcdirs[$i % @srcdirs];
+        write_file("$dir/$src/t$i.c", "");
+        push(@objs, "o/t$i.o");
+        $deps{$i} = join(' ', map { "h/h" . (($i * 7 + $_) % $headers) . ".h" }
+                                  (0 .. ($p->{fanin} || 0) - 1));
+    }
+
+    $mk .= "OBJS :=";
+    for my $o (@objs) {
+        $mk .= " \\\n  $o";
+    }
+    $mk .= "\n\n.PHONY: all clean\n";
+    $mk .= "all: bin\n";
+    $mk .= "bin: \$(OBJS) ; \@touch \$\@\n\n";
+    $mk .= ".SECONDARY:\n\n";
+
+    # Pattern rules which match every object but can't be used, since
+    # their prerequisites don't exist: each search has to try them all.
+    for my $n (0 .. ($p->{patterns} || 0) - 1) {
+        $mk .= "o/%.o: %.y$n ; \@touch \$\@\n";
+    }
+
+    if ($p->{vpath}) {
+        $mk .= "\nvpath %.c " . join(' ', @srcdirs) . "\n";
+    }
+
+    # Chain DEPTH pattern rules from the source to the object.
+    my $prev = $p->{vpath} ? '%.c' : "$srcdirs[0]/%.c";
+    for my $d (1 .. $depth - 1) {
+        $mk .= "o/%.$d: $prev ; \@touch \$\@\n";
+        $prev = "o/%.$d";
+    }
+
+    if ($p->{eval}) {
+        # The same rules, generated one target at a time.
+        (my $src = $prev) =~ s/%/\$1/;
+        $mk .= "\ndefine obj-rule\n"
+             . "o/\$1.o: $src \$(deps-\$1)\n"
+             . "\t\@touch \$\$\@\n"
+             . "endef\n\n";
+        $mk .= join('', map { "deps-t$_ := $deps{$_}\n" } sort { $a <=> $b } keys %deps);
+        $mk .= "\n\$(foreach o,\$(OBJS),\$(eval \$(call obj-rule,\$(basename \$(notdir \$o)))))\n";
+    } else {
+        $mk .= "o/%.o: $prev ; \@touch \$\@\n\n";
+        if ($p->{dfiles}) {
+            for my $i (sort { $a <=> $b } keys %deps) {
+                write_file("$dir/o/t$i.d", "o/t$i.o: $deps{$i}\n$deps{$i}:\n");
+            }
+            $mk .= "-include \$(OBJS:.o=.d)\n";
+        } else {
+            $mk .= join('', map { "o/t$_.o: $deps{$_}\n" } sort { $a <=> $b } keys %deps);
+        }
+    }
+
+    $mk .= "\nclean: ; rm -f o/*.[0-9o] bin\n";
+    write_file("$dir/Makefile", $mk);
+}
+
+sub generate {
+    my ($name, $p) = @_;
+    my $dir = "$workdir/$name";
+    my $targets = floor($p->{targets} * $scale) || 1;
+
+    rmtree($dir);
+    mkpath($dir);
+
+    if (!$p->{recursive}) {
+        generate_unit($dir, $p, 0, $targets);
+        return;
+    }
+
+    my @subs = map { "sub$_" } (0 .. $p->{recursive} - 1);
+    my $per = floor($targets / @subs) || 1;
+    for my $n (0 .. $#subs) {
+        generate_unit("$dir/$subs[$n]", $p, $n * $per, ($n + 1) * $per);
+    }
+    write_file("$dir/Makefile",
+               "# Generated by run_make_bench.pl.\n\n"
+             . "SUBDIRS := @subs\n\n"
+             . ".PHONY: all \$(SUBDIRS)\n"
+             . "all: \$(SUBDIRS)\n"
+             . "\$(SUBDIRS): ; \@\$(MAKE) -C \$\@\n");
+}
+
+# Remove everything the build creates, keeping the generated .d files.
+
+sub clean {
+    my ($dir) = @_;
+    for my $sub (glob("$dir/sub*"), $dir) {
+        unlink("$sub/bin");
+        for my $f (glob("$sub/o/*")) {
+            unlink($f) if $f !~ /\.d$/;
+        }
+    }
+}
+
+my $have_stats;
+
+# Run make with ARGS in DIR, and return its wall and CPU time and, if it
+# has them, its --stats counters summed over all the makes that ran.
+
+sub run_make {
+    my ($dir, @args) = @_;
+    my $out = "$workdir/make.out";
+    my @before = times();
+    my $start = time();
+
+    push(@args, '--stats') if $have_stats;
+
+    my $pid = fork();
+    defined $pid or die "$0: fork: $!\n";
+    if (!$pid) {
+        chdir($dir) or die "$0: $dir: $!\n";
+        open(STDOUT, '>', $out) or die "$0: $out: $!\n";
+        open(STDERR, '>&', \*STDOUT);
+        exec($make, '--no-print-directory', @args);
+        die "$0: $make: $!\n";
+    }
+    waitpid($pid, 0);
+    my $status = $?;
+
+    my %r = (wall => time() - $start);
+    my @after = times();
+    $r{cpu} = ($after[2] - $before[2]) + ($after[3] - $before[3]);
+
+    open(my $fh, '<', $out) or die "$0: $out: $!\n";
+    while (<$fh>) {
+        next if !/^# ([a-z ]+): (\d+)/ || !$stats_keys{$1};
+        my $k = $stats_keys{$1};
+        if ($k eq 'rss_kb') {
+            $r{$k} = $2 if !defined $r{$k} || $2 > $r{$k};
+        } else {
+            $r{$k} = ($r{$k} || 0) + $2;
+        }
+    }
+    close($fh);
+
+    if ($status) {
+        system('cat', $out);
+        die "$0: make @args in $dir failed\n";
+    }
+    unlink($out);
+
+    return \%r;
+}
+
+sub median {
+    my @v = sort { $a <=> $b } @_;
+    return $v[$#v / 2];
+}
+
+# See whether this make has --stats.
+{
+    my $mk = "$workdir/probe.mk";
+    write_file($mk, "all: ; \@:\n");
+    $have_stats = system("\"$make\" -s -f \"$mk\" --stats >/dev/null 2>&1") == 0;
+    unlink($mk);
+}
+
+my %results;
+
+for my $name (@run) {
+    my $p = $scenarios{$name};
+    my $dir = "$workdir/$name";
+    my %runs;
+
+    print "$name: generating...\n";
+    generate($name, $p);
+
+    for my $n (1 .. $repeat) {
+        clean($dir);
+        push(@{$runs{dry}}, run_make($dir, '-n'));
+        push(@{$runs{full}}, run_make($dir, "-j$jobs", '-s'));
+        push(@{$runs{noop}}, run_make($dir));
+    }
+
+    for my $mode (@modes) {
+        my $rs = $runs{$mode};
+        my %r = %{$rs->[-1]};
+        $r{wall} = median(map { $_->{wall} } @$rs);
+        $r{cpu} = median(map { $_->{cpu} } @$rs);
+        $results{"$name/$mode"} = \%r;
+        printf("  %-5s wall %8.3fs  cpu %8.3fs%s\n", $mode, $r{wall}, $r{cpu},
+               defined $r{stat_calls}
+               ? sprintf("  stat %8d  rss %7d kB", $r{stat_calls}, $r{rss_kb} || 0)
+               : '');
+    }
+
+    rmtree($dir) if !$keep;
+}
+
+# Write the results.  Each entry is on a line of its own, which is also
+# what read_results() expects.
+
+sub write_results {
+    my ($file) = @_;
+    my $version = `"$make" --version 2>/dev/null`;
+    ($version) = split(/\n/, $version || 'unknown');
+    $version =~ s/(["\\])/\\$1/g;
+
+    my $json = "{\n";
+    $json .= "  \"make\": \"$version\",\n";
+    $json .= "  \"jobs\": $jobs,\n";
+    $json .= "  \"scale\": $scale,\n";
+    $json .= "  \"results\": {\n";
+    $json .= join(",\n", map {
+        my $r = $results{$_};
+        "    \"$_\": { "
+          . join(', ', map {
+                my $v = $r->{$_};
+                "\"$_\": " . ($v =~ /\./ ? sprintf("%.6f", $v) : $v)
+            } sort keys %$r)
+          . " }"
+    } sort keys %results);
+    $json .= "\n  }\n}\n";
+    write_file($file, $json);
+}
+
+sub read_results {
+    my ($file) = @_;
+    my %r;
+    open(my $fh, '<', $file) or die "$0: $file: $!\n";
+    while (<$fh>) {
+        next if !/^\s*"([^"]+\/[^"]+)": \{(.*)\}/;
+        my ($key, $members) = ($1, $2);
+        while ($members =~ /"(\w+)": ([-0-9.eE+]+)/g) {
+            $r{$key}{$1} = $2;
+        }
+    }
+    close($fh);
+    return \%r;
+}
+
+write_results($output);
+print "Results written to $output\n";
+
+exit(0) if !defined $baseline;
+
+my $base = read_results($baseline);
+my $regressions = 0;
+
+print "\nCompared with $baseline (tolerance $tolerance%):\n";
+for my $key (sort keys %results) {
+    my $b = $base->{$key} or next;
+    my $r = $results{$key};
+    for my $m (sort keys %$r) {
+        next if !defined $b->{$m} || $b->{$m} <= 0;
+        my $change = 100 * ($r->{$m} - $b->{$m}) / $b->{$m};
+        next if $change <= $tolerance;
+        # Times too short to measure reliably aren't regressions.
+        next if ($m eq 'wall' || $m eq 'cpu') && $r->{$m} < 0.05;
+        printf("  %-20s %-18s %12.6g -> %-12.6g (+%.0f%%)\n", $key, $m,
+               $b->{$m}, $r->{$m}, $change);
+        ++$regressions;
+    }
+}
+print $regressions ? "$regressions regressions.\n" : "  No regressions.\n";
+
+exit($regressions ? 1 : 0);